@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "common.h"
+#include "inspect.h"
+
+#define INSPECT_BUFLEN 8192
+
+// copy the value of a "Key:\tvalue" line in dest; returns 1 if not found
+static int inspect_key(const char *buf, const char *key, char *dest, size_t len) {
+	const char *ptr = strstr(buf, key);
+	if (!ptr)
+		return 1;
+	ptr += strlen(key);
+	while (*ptr == ' ' || *ptr == '\t')
+		ptr++;
+
+	size_t i = 0;
+	while (*ptr != '\0' && *ptr != '\n' && i < len - 1)
+		dest[i++] = *ptr++;
+	dest[i] = '\0';
+	return (i == 0)? 1: 0;
+}
+
+int inspect_sandbox(pid_t child, SandboxInspect *si) {
+	memset(si, 0, sizeof(SandboxInspect));
+	if (child == -1)
+		return 1;
+
+	char fname[64];
+	snprintf(fname, sizeof(fname), "/proc/%d/status", child);
+	int fd = open(fname, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return 1;
+
+	// the kernel generates the file on the first read, the loop only picks up the rest of a large buffer
+	char buf[INSPECT_BUFLEN];
+	size_t len = 0;
+	ssize_t rv;
+	while (len < sizeof(buf) - 1 && (rv = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0)
+		len += rv;
+	close(fd);
+	if (len == 0)
+		return 1;
+	buf[len] = '\0';
+
+	char seccomp[8];
+	if (inspect_key(buf, "\nCapBnd:", si->caps, sizeof(si->caps)) ||
+	    inspect_key(buf, "\nSeccomp:", seccomp, sizeof(seccomp)) ||
+	    inspect_key(buf, "\nCpus_allowed_list:", si->cpus, sizeof(si->cpus)))
+		return 1;
+	si->seccomp = atoi(seccomp);
+	return 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef INSPECT_H
+#define INSPECT_H
+#include <sys/types.h>
+
+// Sandbox security settings read directly from /proc/pid/status of the sandboxed process, the same
+// fields reported by firemon --caps, --seccomp and --cpu. The file is read only once.
+
+#define INSPECT_CAPS_LEN 32
+#define INSPECT_CPUS_LEN 256
+typedef struct {
+	char caps[INSPECT_CAPS_LEN];	// CapBnd: capability bounding set, hex
+	int seccomp;			// Seccomp: 0 disabled, 1 strict, 2 filter
+	char cpus[INSPECT_CPUS_LEN];	// Cpus_allowed_list
+} SandboxInspect;
+
+// inspect the sandbox, child is the sandboxed process as found by pid_find_child(); pids array is
+// not used, and the function can be called from any thread; returns 1 if child is -1 or its status
+// file cannot be read (hidepid, sandbox running as a different user), the caller should fall back on firemon
+int inspect_sandbox(pid_t child, SandboxInspect *si);
+
+#endif
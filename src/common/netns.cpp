@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "common.h"
+#include "pid.h"
+#include "netns.h"
+#include <sys/stat.h>
+
+#define NETNS_BUFLEN 16384
+#define NETNS_EXPIRE 10		// cycles; namespaces not used for a while are removed
+
+static NetNs *netns = 0;
+static int netns_cnt = 0;
+static int netns_size = 0;
+static unsigned netns_current = 1;
+
+// namespace of the processes already looked up; the network namespace of the sandbox child is set
+// by clone() and does not change, /proc/pid/ns/net is checked only once for each process
+typedef struct {
+	pid_t pid;
+	unsigned long long start_time;	// pids are reused
+	dev_t dev;
+	ino_t ino;
+	unsigned cycle;		// last cycle the process was looked up
+} NetNsProc;
+static NetNsProc *netns_proc = 0;
+static int netns_proc_cnt = 0;
+static int netns_proc_size = 0;
+
+void netns_cycle(void) {
+	netns_current++;
+
+	int i;
+	for (i = netns_cnt - 1; i >= 0; i--) {
+		if (netns_current - netns[i].cycle > NETNS_EXPIRE) {
+			netns_cnt--;
+			netns[i] = netns[netns_cnt];
+		}
+	}
+	for (i = netns_proc_cnt - 1; i >= 0; i--) {
+		if (netns_current - netns_proc[i].cycle > NETNS_EXPIRE) {
+			netns_proc_cnt--;
+			netns_proc[i] = netns_proc[netns_proc_cnt];
+		}
+	}
+}
+
+// namespace identity of a process, from the cache or from /proc/pid/ns/net
+static void netns_identity(pid_t pid, unsigned long long start_time, dev_t *dev, ino_t *ino) {
+	int i;
+	for (i = 0; i < netns_proc_cnt; i++) {
+		NetNsProc *np = &netns_proc[i];
+		if (np->pid == pid && np->start_time == start_time) {
+			np->cycle = netns_current;
+			*dev = np->dev;
+			*ino = np->ino;
+			return;
+		}
+	}
+
+	// without ptrace access to the process, the namespace is not shared with other sandboxes
+	char fname[64];
+	snprintf(fname, sizeof(fname), "/proc/%d/ns/net", pid);
+	struct stat s;
+	*dev = (dev_t) -1;
+	*ino = (ino_t) pid;
+	if (stat(fname, &s) == 0) {
+		*dev = s.st_dev;
+		*ino = s.st_ino;
+	}
+
+	if (netns_proc_cnt == netns_proc_size) {
+		netns_proc_size = (netns_proc_size)? netns_proc_size * 2: 16;
+		netns_proc = (NetNsProc *) realloc(netns_proc, sizeof(NetNsProc) * netns_proc_size);
+		if (!netns_proc)
+			errExit("realloc");
+	}
+	NetNsProc *np = &netns_proc[netns_proc_cnt++];
+	np->pid = pid;
+	np->start_time = start_time;
+	np->dev = *dev;
+	np->ino = *ino;
+	np->cycle = netns_current;
+}
+
+static const char *parse_ull(const char *ptr, unsigned long long *val) {
+	while (*ptr == ' ')
+		ptr++;
+	unsigned long long rv = 0;
+	while (*ptr >= '0' && *ptr <= '9') {
+		rv = rv * 10 + (*ptr - '0');
+		ptr++;
+	}
+	*val = rv;
+	return ptr;
+}
+
+int netns_parse_dev(const char *buf, NetIf *ifs, int max) {
+	int cnt = 0;
+	const char *ptr = buf;
+
+	while (*ptr != '\0' && cnt < max) {
+		const char *eol = strchr(ptr, '\n');
+		const char *colon = strchr(ptr, ':');
+		// the first two lines are headers, without ':'
+		if (!colon || (eol && colon > eol)) {
+			if (!eol)
+				break;
+			ptr = eol + 1;
+			continue;
+		}
+
+		// interface name
+		while (*ptr == ' ')
+			ptr++;
+		int len = colon - ptr;
+		if (len >= NETNS_IFNAME_LEN)
+			len = NETNS_IFNAME_LEN - 1;
+		NetIf *netif = &ifs[cnt];
+		memcpy(netif->name, ptr, len);
+		netif->name[len] = '\0';
+
+		// receive: bytes packets errs drop fifo frame compressed multicast
+		// transmit: bytes packets errs drop fifo colls carrier compressed
+		unsigned long long val[16];
+		int i;
+		ptr = colon + 1;
+		for (i = 0; i < 16; i++)
+			ptr = parse_ull(ptr, &val[i]);
+		netif->rx_bytes = val[0];
+		netif->rx_packets = val[1];
+		netif->rx_drop = val[3];
+		netif->tx_bytes = val[8];
+		netif->tx_packets = val[9];
+		netif->tx_drop = val[11];
+		cnt++;
+
+		if (!eol)
+			break;
+		ptr = eol + 1;
+	}
+
+	return cnt;
+}
+
+static float netns_rate(unsigned long long now, unsigned long long before, float interval) {
+	if (now < before)
+		return 0;	// counters reset, the interface was recreated
+	return (float) (now - before) / interval;
+}
+
+// read net/dev again and update the rates
+static void netns_read(NetNs *ns, pid_t pid) {
+	ns->cycle = netns_current;
+
+	char fname[64];
+	snprintf(fname, sizeof(fname), "/proc/%d/net/dev", pid);
+	int fd = open(fname, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return;
+	char buf[NETNS_BUFLEN];
+	ssize_t len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return;
+	buf[len] = '\0';
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	float interval = 0;
+	if (ns->ts.tv_sec || ns->ts.tv_nsec)
+		interval = (float) (ts.tv_sec - ns->ts.tv_sec) + (float) (ts.tv_nsec - ns->ts.tv_nsec) / 1000000000;
+	ns->ts = ts;
+
+	NetIf ifs[NETNS_MAX_IF];
+	int cnt = netns_parse_dev(buf, ifs, NETNS_MAX_IF);
+	ns->rx = 0;
+	ns->tx = 0;
+	int i;
+	for (i = 0; i < cnt; i++) {
+		NetIf *netif = &ifs[i];
+		netif->rx = netif->tx = netif->rx_pkts = netif->tx_pkts = netif->drops = 0;
+
+		// previous values
+		int j;
+		for (j = 0; j < ns->ifcnt && interval > 0; j++) {
+			NetIf *old = &ns->ifs[j];
+			if (strcmp(old->name, netif->name))
+				continue;
+			netif->rx = netns_rate(netif->rx_bytes, old->rx_bytes, interval);
+			netif->tx = netns_rate(netif->tx_bytes, old->tx_bytes, interval);
+			netif->rx_pkts = netns_rate(netif->rx_packets, old->rx_packets, interval);
+			netif->tx_pkts = netns_rate(netif->tx_packets, old->tx_packets, interval);
+			netif->drops = netns_rate(netif->rx_drop, old->rx_drop, interval) +
+				netns_rate(netif->tx_drop, old->tx_drop, interval);
+			break;
+		}
+
+		if (strcmp(netif->name, "lo")) {
+			ns->rx += netif->rx;
+			ns->tx += netif->tx;
+		}
+	}
+
+	memcpy(ns->ifs, ifs, sizeof(NetIf) * cnt);
+	ns->ifcnt = cnt;
+}
+
+const NetNs *netns_sandbox(pid_t pid) {
+	// the network namespace is the namespace of the first child
+	pid_t child = 1;
+	unsigned long long start_time = 0;
+	if (pid != 1) {
+		Process *p = pid_find(pid);
+		if (!p || !p->first_child)
+			return NULL;
+		child = p->first_child;
+		Process *c = pid_find(child);
+		if (c)
+			start_time = c->start_time;
+	}
+
+	dev_t dev;
+	ino_t ino;
+	netns_identity(child, start_time, &dev, &ino);
+
+	int i;
+	for (i = 0; i < netns_cnt; i++) {
+		if (netns[i].dev == dev && netns[i].ino == ino)
+			break;
+	}
+	if (i == netns_cnt) {
+		if (netns_cnt == netns_size) {
+			netns_size = (netns_size)? netns_size * 2: 16;
+			netns = (NetNs *) realloc(netns, sizeof(NetNs) * netns_size);
+			if (!netns)
+				errExit("realloc");
+		}
+		memset(&netns[i], 0, sizeof(NetNs));
+		netns[i].dev = dev;
+		netns[i].ino = ino;
+		netns_cnt++;
+	}
+
+	if (netns[i].cycle != netns_current)
+		netns_read(&netns[i], child);
+	return &netns[i];
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef NETNS_H
+#define NETNS_H
+#include <sys/types.h>
+#include <time.h>
+
+// Network statistics by network namespace. Sandboxes sharing a namespace (--join-network, --net=none,
+// or no --net at all) are mapped to the same entry, and /proc/pid/net/dev is read only once per cycle
+// for each namespace. The loopback interface is excluded from the namespace totals.
+
+#define NETNS_IFNAME_LEN 16
+#define NETNS_MAX_IF 16	// interfaces reported for a namespace; the totals include all of them
+typedef struct {
+	char name[NETNS_IFNAME_LEN];
+	// counters, as read from net/dev
+	unsigned long long rx_bytes;
+	unsigned long long rx_packets;
+	unsigned long long rx_drop;
+	unsigned long long tx_bytes;
+	unsigned long long tx_packets;
+	unsigned long long tx_drop;
+	// rates since the previous cycle, per second
+	float rx;		// bytes
+	float tx;		// bytes
+	float rx_pkts;
+	float tx_pkts;
+	float drops;		// rx and tx
+} NetIf;
+
+typedef struct {
+	dev_t dev;		// namespace identity, from /proc/pid/ns/net
+	ino_t ino;
+	unsigned cycle;		// last cycle the namespace was read
+	struct timespec ts;	// time of the last read, 0 if never read
+	int ifcnt;
+	NetIf ifs[NETNS_MAX_IF];
+	float rx;		// bytes/s, all interfaces except lo
+	float tx;
+} NetNs;
+
+// start a new cycle; the namespaces are read again on first use
+void netns_cycle(void);
+
+// network namespace of the sandbox, pid 1 for the system namespace; NULL if not available
+const NetNs *netns_sandbox(pid_t pid);
+
+// parse the content of /proc/pid/net/dev in ifs array; returns the number of interfaces found
+int netns_parse_dev(const char *buf, NetIf *ifs, int max);
+
+#endif
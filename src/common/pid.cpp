@@ -26,184 +26,690 @@
 #include <sys/ioctl.h>
 #include <dirent.h>
 #include <limits.h>
+#include <sys/resource.h>
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#define HAVE_IO_URING
+#endif
+#endif
+#endif
 
 #define PIDS_BUFLEN 4096
 Process *pids = 0;
-ProcessData *pids_data = 0;
-int pids_first = 0;
-int pids_last = 0;
-int max_pids = 32769;
-static int pid_proc_cmdline_x11_xpra_xephyr(const pid_t pid);
+int pids_cnt = 0;
+static int pids_size = 0;
+
+// open addressing hash table, pid -> index in pids array, -1 for empty slots
+static int *pids_index = 0;
+static unsigned pids_index_mask = 0;
+
+// all the processes found by pid_read() scan, in /proc order
+typedef struct {
+	pid_t pid;
+	pid_t parent;
+	unsigned utime;
+	unsigned stime;
+	unsigned long long minflt;
+	unsigned long long majflt;
+	unsigned long long start_time;
+	bool candidate;		// main firejail process candidate
+	unsigned char level;
+} ScanEntry;
+static ScanEntry *scan = 0;
+static int scan_cnt = 0;
+static int scan_size = 0;
+static int *scan_path = 0;
+static int pid_proc_cmdline_x11_xpra_xephyr(const pid_t pid, const char *comm);
+
+// /proc directory, opened once
+static int proc_fd = -1;
+
+// open a /proc/pid file relative to /proc directory
+static int pid_open_file(pid_t pid, const char *name) {
+	char fname[64];
+	if (proc_fd == -1)
+		proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (proc_fd == -1) {
+		snprintf(fname, sizeof(fname), "/proc/%d/%s", pid, name);
+		return open(fname, O_RDONLY | O_CLOEXEC);
+	}
 
-// get the memory associated with this pid
-void pid_getmem(unsigned pid, unsigned *rss, unsigned *shared) {
-	// open stat file
-	char *file;
-	if (asprintf(&file, "/proc/%u/statm", pid) == -1) {
-		perror("asprintf");
-		exit(1);
+	snprintf(fname, sizeof(fname), "%d/%s", pid, name);
+	return openat(proc_fd, fname, O_RDONLY | O_CLOEXEC);
+}
+
+// read a /proc/pid file in buf; returns the number of bytes read, -1 if error
+static ssize_t pid_read_file(pid_t pid, const char *name, char *buf, size_t len) {
+	int fd = pid_open_file(pid, name);
+	if (fd == -1)
+		return -1;
+	ssize_t rv = read(fd, buf, len - 1);
+	close(fd);
+	if (rv <= 0)
+		return -1;
+	buf[rv] = '\0';
+	return rv;
+}
+
+// parse an unsigned decimal number; returns a pointer to the first character after the number
+static inline const char *parse_number(const char *ptr, unsigned long long *val) {
+	unsigned long long rv = 0;
+	while (*ptr >= '0' && *ptr <= '9')
+		rv = rv * 10 + (*ptr++ - '0');
+	*val = rv;
+	return ptr;
+}
+
+// skip the current field and the spaces after it
+static inline const char *skip_field(const char *ptr) {
+	while (*ptr != ' ' && *ptr != '\0')
+		ptr++;
+	while (*ptr == ' ')
+		ptr++;
+	return ptr;
+}
+
+// parse /proc/pid/stat; returns 1 if error
+static int parse_stat(const char *buf, ProcSnapshot *snap) {
+	// the executable name is enclosed in parentheses, and it can contain spaces and parentheses
+	const char *start = strchr(buf, '(');
+	const char *end = strrchr(buf, ')');
+	if (!start || !end || end < start)
+		return 1;
+	size_t len = end - start - 1;
+	if (len >= sizeof(snap->name))
+		len = sizeof(snap->name) - 1;
+	memcpy(snap->name, start + 1, len);
+	snap->name[len] = '\0';
+
+	// field 3 is the process state
+	const char *ptr = end + 1;
+	while (*ptr == ' ')
+		ptr++;
+	if (*ptr == '\0')
+		return 1;
+	snap->state = *ptr;
+
+	// numerical fields, starting with field 4
+	int field;
+	ptr = skip_field(ptr);
+	for (field = 4; field <= 22 && *ptr != '\0'; field++) {
+		unsigned long long val;
+		switch (field) {
+			case 4:
+				parse_number(ptr, &val);
+				snap->parent = (pid_t) val;
+				break;
+			case 10:
+				parse_number(ptr, &snap->minflt);
+				break;
+			case 12:
+				parse_number(ptr, &snap->majflt);
+				break;
+			case 14:
+				parse_number(ptr, &val);
+				snap->utime = (unsigned) val;
+				break;
+			case 15:
+				parse_number(ptr, &val);
+				snap->stime = (unsigned) val;
+				break;
+			case 22:
+				parse_number(ptr, &val);
+				snap->start_time = val;
+				return 0;
+		}
+		ptr = skip_field(ptr);
 	}
 
-	FILE *fp = fopen(file, "r");
-	if (!fp) {
-		free(file);
-		return;
+	return 1;
+}
+
+// parse /proc/pid/statm; returns 1 if error
+static int parse_statm(const char *buf, ProcSnapshot *snap) {
+	unsigned long long val;
+	const char *ptr = skip_field(buf); // total program size
+	if (*ptr == '\0')
+		return 1;
+	ptr = parse_number(ptr, &val);
+	snap->rss = (unsigned) val;
+	while (*ptr == ' ')
+		ptr++;
+	if (*ptr == '\0')
+		return 1;
+	parse_number(ptr, &val);
+	snap->shared = (unsigned) val;
+	return 0;
+}
+
+// parse a "Key:   value" line; returns 1 if not found
+static int parse_key(const char *buf, const char *key, unsigned long long *val) {
+	const char *ptr = strstr(buf, key);
+	if (!ptr)
+		return 1;
+	ptr += strlen(key);
+	while (*ptr == ' ' || *ptr == '\t')
+		ptr++;
+	if (*ptr < '0' || *ptr > '9')
+		return 1;
+
+	parse_number(ptr, val);
+	return 0;
+}
+
+// same for a value in kB
+static int parse_kb(const char *buf, const char *key, unsigned *kb) {
+	unsigned long long val;
+	if (parse_key(buf, key, &val))
+		return 1;
+	*kb = (unsigned) val;
+	return 0;
+}
+
+// parse the real uid and the context switches in /proc/pid/status; returns 1 if error
+static int parse_status(const char *buf, ProcSnapshot *snap) {
+	unsigned long long val;
+	if (parse_key(buf, "\nUid:", &val))
+		return 1;
+	snap->uid = (uid_t) val;
+
+	if (parse_key(buf, "\nvoluntary_ctxt_switches:", &snap->vcsw))
+		snap->vcsw = 0;
+	if (parse_key(buf, "\nnonvoluntary_ctxt_switches:", &snap->nvcsw))
+		snap->nvcsw = 0;
+	return 0;
+}
+
+// parse /proc/pid/schedstat: time on the cpu, time waiting on a runqueue, timeslices; returns 1 if error
+static int parse_schedstat(const char *buf, ProcSnapshot *snap) {
+	unsigned long long val;
+	const char *ptr = skip_field(buf); // time on the cpu
+	if (*ptr < '0' || *ptr > '9')
+		return 1;
+	parse_number(ptr, &val);
+	snap->run_delay = val;
+	return 0;
+}
+
+// parse /proc/pid/smaps_rollup; returns 1 if error
+static int parse_smaps_rollup(const char *buf, ProcSnapshot *snap) {
+	if (parse_kb(buf, "\nPss:", &snap->pss) ||
+	    parse_kb(buf, "\nPrivate_Clean:", &snap->private_clean) ||
+	    parse_kb(buf, "\nPrivate_Dirty:", &snap->private_dirty))
+		return 1;
+	// swap accounting might be disabled in the kernel
+	if (parse_kb(buf, "\nSwap:", &snap->swap))
+		snap->swap = 0;
+	return 0;
+}
+
+// parse /proc/pid/io; returns 1 if error
+static int parse_io(const char *buf, ProcSnapshot *snap) {
+	if (parse_key(buf, "\nsyscr:", &snap->syscr) ||
+	    parse_key(buf, "\nsyscw:", &snap->syscw) ||
+	    parse_key(buf, "\nread_bytes:", &snap->read_bytes) ||
+	    parse_key(buf, "\nwrite_bytes:", &snap->write_bytes))
+		return 1;
+	return 0;
+}
+
+// read the process data selected by flags; returns 1 if error
+int pid_snapshot(pid_t pid, ProcSnapshot *snap, int flags) {
+	char buf[PIDS_BUFLEN];
+
+	if (flags & SNAP_STAT) {
+		if (pid_read_file(pid, "stat", buf, sizeof(buf)) == -1 || parse_stat(buf, snap))
+			return 1;
+	}
+	if (flags & SNAP_STATM) {
+		if (pid_read_file(pid, "statm", buf, sizeof(buf)) == -1 || parse_statm(buf, snap))
+			return 1;
+	}
+	if (flags & SNAP_STATUS) {
+		if (pid_read_file(pid, "status", buf, sizeof(buf)) == -1 || parse_status(buf, snap))
+			return 1;
+	}
+	if (flags & SNAP_SMAPS) {
+		if (pid_read_file(pid, "smaps_rollup", buf, sizeof(buf)) == -1 || parse_smaps_rollup(buf, snap))
+			return 1;
+	}
+	if (flags & SNAP_IO) {
+		if (pid_read_file(pid, "io", buf, sizeof(buf)) == -1 || parse_io(buf, snap))
+			return 1;
 	}
-	free(file);
+	if (flags & SNAP_SCHED) {
+		if (pid_read_file(pid, "schedstat", buf, sizeof(buf)) == -1 || parse_schedstat(buf, snap))
+			return 1;
+	}
+
+	return 0;
+}
 
-	unsigned a, b, c;
-	if (3 != fscanf(fp, "%u %u %u", &a, &b, &c)) {
-		fclose(fp);
+// get the memory associated with this pid
+void pid_getmem(unsigned pid, unsigned *rss, unsigned *shared) {
+	ProcSnapshot snap;
+	if (pid_snapshot(pid, &snap, SNAP_STATM))
 		return;
-	}
-	*rss += b;
-	*shared += c;
-	fclose(fp);
+	*rss += snap.rss;
+	*shared += snap.shared;
 }
 
 
 void pid_get_cpu_time(unsigned pid, unsigned *utime, unsigned *stime) {
-	// open stat file
-	char *file;
-	if (asprintf(&file, "/proc/%u/stat", pid) == -1) {
-		perror("asprintf");
-		exit(1);
-	}
-	FILE *fp = fopen(file, "r");
-	if (!fp) {
-		free(file);
+	ProcSnapshot snap;
+	if (pid_snapshot(pid, &snap, SNAP_STAT))
+		return;
+	*utime = snap.utime;
+	*stime = snap.stime;
+}
+
+unsigned long long pid_get_start_time(unsigned pid) {
+	ProcSnapshot snap;
+	if (pid_snapshot(pid, &snap, SNAP_STAT))
+		return 0;
+	return snap.start_time;
+}
+
+char *pid_get_user_name(uid_t uid) {
+	struct passwd *pw = getpwuid(uid);
+	if (pw)
+		return strdup(pw->pw_name);
+	return NULL;
+}
+
+uid_t pid_get_uid(pid_t pid) {
+	ProcSnapshot snap;
+	if (pid_snapshot(pid, &snap, SNAP_STATUS))
+		return 0;
+	return snap.uid;
+}
+
+
+static inline unsigned pid_hash(pid_t pid) {
+	return ((unsigned) pid * 2654435761u) & pids_index_mask;
+}
+
+Process *pid_find(pid_t pid) {
+	if (!pids_index)
+		return NULL;
+
+	unsigned slot = pid_hash(pid);
+	while (pids_index[slot] != -1) {
+		if (pids[pids_index[slot]].pid == pid)
+			return &pids[pids_index[slot]];
+		slot = (slot + 1) & pids_index_mask;
+	}
+	return NULL;
+}
+
+static void pid_index_insert(int index) {
+	unsigned slot = pid_hash(pids[index].pid);
+	while (pids_index[slot] != -1)
+		slot = (slot + 1) & pids_index_mask;
+	pids_index[slot] = index;
+}
+
+// keep the hash table at most half full
+static void pid_index_resize(void) {
+	if (pids_index && (unsigned) pids_cnt * 2 <= pids_index_mask)
 		return;
+
+	unsigned size = (pids_index)? (pids_index_mask + 1) * 2: 256;
+	while ((unsigned) pids_cnt * 2 > size - 1)
+		size *= 2;
+	free(pids_index);
+	pids_index = (int *) malloc(sizeof(int) * size);
+	if (!pids_index)
+		errExit("malloc");
+	memset(pids_index, 0xff, sizeof(int) * size);
+	pids_index_mask = size - 1;
+
+	int i;
+	for (i = 0; i < pids_cnt; i++)
+		pid_index_insert(i);
+}
+
+// file descriptors kept open in pids array, limited to half of RLIMIT_NOFILE
+static int fds_cnt = 0;
+static int fds_max = -1;
+
+static bool pid_fd_available(void) {
+	if (fds_max == -1) {
+		struct rlimit rl;
+		if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+			fds_max = rl.rlim_cur / 2;
+		else
+			fds_max = 512;
 	}
-	free(file);
+	return fds_cnt < fds_max;
+}
 
-	char line[PIDS_BUFLEN];
-	if (fgets(line, PIDS_BUFLEN - 1, fp)) {
-		char *ptr = line;
-		// jump 13 fields
-		int i;
-		for (i = 0; i < 13; i++) {
-			while (*ptr != ' ' && *ptr != '\t' && *ptr != '\0')
-				ptr++;
-			if (*ptr == '\0')
-				goto myexit;
-			ptr++;
-		}
-		if (2 != sscanf(ptr, "%u %u", utime, stime))
-			goto myexit;
+// read a /proc/pid file using a descriptor kept open in pids array;
+// returns the number of bytes read, -1 if error
+static ssize_t pid_pread_file(Process *p, int *fd, const char *name, char *buf, size_t len) {
+	if (*fd == -1) {
+		// no descriptors left, open the file every time
+		if (!pid_fd_available())
+			return pid_read_file(p->pid, name, buf, len);
+
+		*fd = pid_open_file(p->pid, name);
+		if (*fd == -1)
+			return -1;
+		fds_cnt++;
 	}
 
-myexit:
-	fclose(fp);
+	// ESRCH if the process is gone
+	ssize_t rv = pread(*fd, buf, len - 1, 0);
+	if (rv <= 0)
+		return -1;
+	buf[rv] = '\0';
+	return rv;
 }
 
-unsigned long long pid_get_start_time(unsigned pid) {
-	// open stat file
-	char *file;
-	if (asprintf(&file, "/proc/%u/stat", pid) == -1) {
-		perror("asprintf");
-		exit(1);
-	}
-	FILE *fp = fopen(file, "r");
-	if (!fp) {
-		free(file);
-		return 0;
+static void pid_close_fds(Process *p) {
+	if (p->stat_fd != -1) {
+		close(p->stat_fd);
+		p->stat_fd = -1;
+		fds_cnt--;
+	}
+	if (p->statm_fd != -1) {
+		close(p->statm_fd);
+		p->statm_fd = -1;
+		fds_cnt--;
 	}
-	free(file);
+}
 
-	char line[PIDS_BUFLEN];
-	unsigned long long retval = 0;
-	if (fgets(line, PIDS_BUFLEN - 1, fp)) {
-		char *ptr = line;
-		// jump 21 fields
-		int i;
-		for (i = 0; i < 21; i++) {
-			while (*ptr != ' ' && *ptr != '\t' && *ptr != '\0')
-				ptr++;
-			if (*ptr == '\0')
-				goto myexit;
-			ptr++;
+static Process *pid_add(pid_t pid) {
+	assert(pid_find(pid) == NULL);
+	if (pids_cnt == pids_size) {
+		pids_size = (pids_size)? pids_size * 2: 128;
+		pids = (Process *) realloc(pids, sizeof(Process) * pids_size);
+		if (!pids)
+			errExit("realloc");
+	}
+
+	Process *p = &pids[pids_cnt++];
+	memset(p, 0, sizeof(Process));
+	p->pid = pid;
+	p->stat_fd = -1;
+	p->statm_fd = -1;
+	pid_index_resize();
+	pid_index_insert(pids_cnt - 1);
+	return p;
+}
+
+// remove the process from the hash table, and move the last process in its place in pids array
+static void pid_remove(pid_t pid) {
+	unsigned slot = pid_hash(pid);
+	while (pids_index[slot] != -1 && pids[pids_index[slot]].pid != pid)
+		slot = (slot + 1) & pids_index_mask;
+	if (pids_index[slot] == -1)
+		return;
+	int index = pids_index[slot];
+	pid_close_fds(&pids[index]);
+
+	// backward shift deletion, no tombstones
+	unsigned hole = slot;
+	slot = (slot + 1) & pids_index_mask;
+	while (pids_index[slot] != -1) {
+		unsigned home = pid_hash(pids[pids_index[slot]].pid);
+		if (((slot - home) & pids_index_mask) >= ((slot - hole) & pids_index_mask)) {
+			pids_index[hole] = pids_index[slot];
+			hole = slot;
 		}
-		if (1 != sscanf(ptr, "%llu", &retval))
-			goto myexit;
+		slot = (slot + 1) & pids_index_mask;
 	}
+	pids_index[hole] = -1;
+
+	// fill the gap in pids array
+	int last = pids_cnt - 1;
+	if (index != last) {
+		pids[index] = pids[last];
+		slot = pid_hash(pids[index].pid);
+		while (pids_index[slot] != last)
+			slot = (slot + 1) & pids_index_mask;
+		pids_index[slot] = index;
+	}
+	pids_cnt--;
+}
 
-myexit:
-	fclose(fp);
-	return retval;
+// find a process in scan array, sorted by pid; returns -1 if not found
+static int scan_find(pid_t pid) {
+	int first = 0;
+	int last = scan_cnt - 1;
+	while (first <= last) {
+		int middle = (first + last) / 2;
+		if (scan[middle].pid == pid)
+			return middle;
+		if (scan[middle].pid < pid)
+			first = middle + 1;
+		else
+			last = middle - 1;
+	}
+	return -1;
 }
 
-char *pid_get_user_name(uid_t uid) {
-	struct passwd *pw = getpwuid(uid);
-	if (pw)
-		return strdup(pw->pw_name);
-	return NULL;
+static int scan_compare(const void *a, const void *b) {
+	return ((const ScanEntry *) a)->pid - ((const ScanEntry *) b)->pid;
 }
 
-uid_t pid_get_uid(pid_t pid) {
-	uid_t rv = 0;
+#define LEVEL_UNKNOWN 0xff
+#define LEVEL_VISITING 0xfe
+#define LEVEL_MAX 0xfd
+
+// resolve the sandbox level using the parent links, regardless of the order the processes were found in /proc
+static void scan_level(int index) {
+	int depth = 0;
+	int i = index;
+	while (i != -1 && scan[i].level == LEVEL_UNKNOWN) {
+		scan[i].level = LEVEL_VISITING;
+		scan_path[depth++] = i;
+		i = scan_find(scan[i].parent);
+	}
 
-	// open stat file
-	char *file;
-	if (asprintf(&file, "/proc/%u/status", pid) == -1) {
-		perror("asprintf");
-		exit(1);
+	// a loop in parent links is possible only if pids were recycled during the scan
+	unsigned char level = (i == -1 || scan[i].level == LEVEL_VISITING)? 0: scan[i].level;
+	while (depth > 0) {
+		i = scan_path[--depth];
+		// processes started inside a sandbox, including firejail processes, belong to the sandbox
+		if (level > 0)
+			level = (level == LEVEL_MAX)? LEVEL_MAX: level + 1;
+		else if (scan[i].candidate)
+			level = 1;
+		scan[i].level = level;
 	}
-	FILE *fp = fopen(file, "r");
-	if (!fp) {
-		free(file);
-		return 0;
+}
+
+// parallel /proc scan: the pid list read from /proc is split in contiguous ranges,
+// each range is parsed by one worker in its own buffer, and the buffers are
+// concatenated in /proc order afterwards
+#define SCAN_WORKERS_MAX 16
+#define SCAN_PIDS_PER_WORKER 256	// below this, the threads cost more than they save
+typedef struct {
+	pthread_t thread;
+	int first;		// range in scan_pids
+	int last;
+	ScanEntry *entries;	// thread-local results
+	int cnt;
+	int size;
+	unsigned generation;	// last scan started, set under scan_mutex before the thread is created
+} ScanWorker;
+static pid_t *scan_pids = 0;
+static int scan_pids_cnt = 0;
+static int scan_pids_size = 0;
+static pid_t scan_mon_pid = 0;
+static ScanWorker scan_workers[SCAN_WORKERS_MAX];
+static int scan_workers_cnt = 0;	// threads started; worker 0 is the calling thread
+static int scan_workers_max = -1;
+static unsigned scan_generation = 0;
+static int scan_pending = 0;
+static pthread_mutex_t scan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scan_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t scan_done = PTHREAD_COND_INITIALIZER;
+
+static void scan_range(ScanWorker *w) {
+	w->cnt = 0;
+	int i;
+	for (i = w->first; i < w->last; i++) {
+		pid_t pid = scan_pids[i];
+		ProcSnapshot snap;
+		if (pid_snapshot(pid, &snap, SNAP_STAT))
+			continue;
+
+		if (w->cnt == w->size) {
+			w->size = (w->size)? w->size * 2: 256;
+			w->entries = (ScanEntry *) realloc(w->entries, sizeof(ScanEntry) * w->size);
+			if (!w->entries)
+				errExit("realloc");
+		}
+		ScanEntry *s = &w->entries[w->cnt++];
+		s->pid = pid;
+		s->parent = snap.parent;
+		s->utime = snap.utime;
+		s->stime = snap.stime;
+		s->minflt = snap.minflt;
+		s->majflt = snap.majflt;
+		s->start_time = snap.start_time;
+		s->level = LEVEL_UNKNOWN;
+
+		// look for firejail executable name
+		s->candidate = false;
+		if (snap.state != 'Z' && (strncmp(snap.name, "firejail", 8) == 0) && (scan_mon_pid == 0 || scan_mon_pid == pid))
+			s->candidate = !pid_proc_cmdline_x11_xpra_xephyr(pid, snap.name);
 	}
+}
 
-	// look for firejail executable name
-	char buf[PIDS_BUFLEN];
-	while (fgets(buf, PIDS_BUFLEN - 1, fp)) {
-		if (strncmp(buf, "Uid:", 4) == 0) {
-			char *ptr = buf + 5;
-			while (*ptr != '\0' && (*ptr == ' ' || *ptr == '\t')) {
-				ptr++;
-			}
-			if (*ptr == '\0')
-				goto doexit;
+static void *scan_worker(void *arg) {
+	ScanWorker *w = (ScanWorker *) arg;
+
+	while (1) {
+		pthread_mutex_lock(&scan_mutex);
+		while (w->generation == scan_generation)
+			pthread_cond_wait(&scan_start, &scan_mutex);
+		w->generation = scan_generation;
+		pthread_mutex_unlock(&scan_mutex);
+
+		scan_range(w);
+
+		pthread_mutex_lock(&scan_mutex);
+		if (--scan_pending == 0)
+			pthread_cond_signal(&scan_done);
+		pthread_mutex_unlock(&scan_mutex);
+	}
 
-			rv = atoi(ptr);
-			break; // break regardless!
+	return NULL;
+}
+
+void pid_set_scan_workers(int n) {
+	if (n < 1)
+		n = 1;
+	if (n > SCAN_WORKERS_MAX)
+		n = SCAN_WORKERS_MAX;
+	scan_workers_max = n;
+}
+
+// number of workers for this scan, starting new threads if necessary
+static int scan_workers_get(void) {
+	if (scan_workers_max == -1) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		pid_set_scan_workers((cpus > 0)? (int) cpus: 1);
+	}
+
+	int n = scan_pids_cnt / SCAN_PIDS_PER_WORKER;
+	if (n > scan_workers_max)
+		n = scan_workers_max;
+	if (n < 1)
+		n = 1;
+
+	// worker threads are started on demand and never stopped; a new thread waits for the next
+	// scan, not for one of the scans that already ran
+	if (scan_workers_cnt == 0)
+		scan_workers_cnt = 1;
+	while (scan_workers_cnt < n) {
+		pthread_mutex_lock(&scan_mutex);
+		scan_workers[scan_workers_cnt].generation = scan_generation;
+		pthread_mutex_unlock(&scan_mutex);
+
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		int rv = pthread_create(&scan_workers[scan_workers_cnt].thread, &attr, scan_worker, &scan_workers[scan_workers_cnt]);
+		pthread_attr_destroy(&attr);
+		if (rv) {
+			// run with the threads we already have
+			scan_workers_max = scan_workers_cnt;
+			break;
 		}
+		scan_workers_cnt++;
 	}
-doexit:
-	fclose(fp);
-	free(file);
-	return rv;
+	if (n > scan_workers_cnt)
+		n = scan_workers_cnt;
+
+	return n;
 }
 
+// read the stat file for all the pids in scan_pids, and store the results in scan array
+static void scan_pids_read(void) {
+	int n = scan_workers_get();
 
-// recursivity!!!
+	// split the pids in n contiguous ranges
+	int i;
+	int chunk = scan_pids_cnt / n;
+	for (i = 0; i < n; i++) {
+		scan_workers[i].first = i * chunk;
+		scan_workers[i].last = (i == n - 1)? scan_pids_cnt: (i + 1) * chunk;
+	}
+
+	if (n > 1) {
+		// the rest of the workers are sleeping, only the first n - 1 threads are woken up
+		pthread_mutex_lock(&scan_mutex);
+		for (i = n; i < scan_workers_cnt; i++)
+			scan_workers[i].first = scan_workers[i].last = 0;
+		scan_pending = scan_workers_cnt - 1;
+		scan_generation++;
+		pthread_cond_broadcast(&scan_start);
+		pthread_mutex_unlock(&scan_mutex);
+	}
+
+	scan_range(&scan_workers[0]);
+
+	if (n > 1) {
+		pthread_mutex_lock(&scan_mutex);
+		while (scan_pending)
+			pthread_cond_wait(&scan_done, &scan_mutex);
+		pthread_mutex_unlock(&scan_mutex);
+	}
+
+	// merge
+	int cnt = 0;
+	for (i = 0; i < n; i++)
+		cnt += scan_workers[i].cnt;
+	if (cnt > scan_size) {
+		while (scan_size < cnt)
+			scan_size = (scan_size)? scan_size * 2: 1024;
+		scan = (ScanEntry *) realloc(scan, sizeof(ScanEntry) * scan_size);
+		scan_path = (int *) realloc(scan_path, sizeof(int) * scan_size);
+		if (!scan || !scan_path)
+			errExit("realloc");
+	}
+	scan_cnt = 0;
+	for (i = 0; i < n; i++) {
+		if (scan_workers[i].cnt)
+			memcpy(scan + scan_cnt, scan_workers[i].entries, sizeof(ScanEntry) * scan_workers[i].cnt);
+		scan_cnt += scan_workers[i].cnt;
+	}
+}
 
 // mon_pid: pid of sandbox to be monitored, 0 if all sandboxes are included
 void pid_read(pid_t mon_pid) {
 //timetrace_start();
-	if (pids == NULL) {
-		FILE *fp = fopen("/proc/sys/kernel/pid_max", "r");
-		if (fp) {
-			int val;
-			if (fscanf(fp, "%d", &val) == 1) {
-				if (val >= max_pids)
-					max_pids = val + 1;
-			}
-			fclose(fp);
-		}
-		pids = (Process *) malloc(sizeof(Process) * max_pids + 1);
-		if (pids == NULL)
-			errExit("malloc");
-		memset(pids, 0, sizeof(Process) * max_pids);
-		pids_data = (ProcessData *) malloc(sizeof(ProcessData) * max_pids + 1);
-		if (pids == NULL)
-			errExit("malloc");
-		memset(pids_data, 0, sizeof(Process) * max_pids);
-	}
-
-	memset(pids + pids_first, 0, sizeof(Process) * (pids_last - pids_first + 1));
-	pids_first = 0;
-	pids_last = 0;
 	pid_t mypid = getpid();
 
 	DIR *dir;
@@ -216,97 +722,206 @@ void pid_read(pid_t mon_pid) {
 		}
 	}
 
-	pid_t child = -1;
 	struct dirent *entry;
 	char *end;
-	while (child < 0 && (entry = readdir(dir))) {
+	scan_pids_cnt = 0;
+	while ((entry = readdir(dir))) {
 		pid_t pid = strtol(entry->d_name, &end, 10);
-		pid %= max_pids;
-		pids_last = pid;
 		if (end == entry->d_name || *end)
 			continue;
 		if (pid == mypid)
 			continue;
 
-		// open stat file
-		char *file;
-		if (asprintf(&file, "/proc/%u/status", pid) == -1) {
-			perror("asprintf");
-			exit(1);
+		if (scan_pids_cnt == scan_pids_size) {
+			scan_pids_size = (scan_pids_size)? scan_pids_size * 2: 1024;
+			scan_pids = (pid_t *) realloc(scan_pids, sizeof(pid_t) * scan_pids_size);
+			if (!scan_pids)
+				errExit("realloc");
 		}
-		FILE *fp = fopen(file, "r");
-		if (!fp) {
-			free(file);
+		scan_pids[scan_pids_cnt++] = pid;
+	}
+	closedir(dir);
+
+	// /proc directory is opened here, before the workers start using it
+	if (proc_fd == -1)
+		proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	scan_mon_pid = mon_pid;
+	scan_pids_read();
+
+	bool sorted = true;
+	int i;
+	for (i = 1; i < scan_cnt && sorted; i++) {
+		if (scan[i].pid < scan[i - 1].pid)
+			sorted = false;
+	}
+	if (!sorted)
+		qsort(scan, scan_cnt, sizeof(ScanEntry), scan_compare);
+
+	// update pids array; keep only sandboxed processes
+	for (i = 0; i < pids_cnt; i++)
+		pids[i].seen = false;
+	for (i = 0; i < scan_cnt; i++) {
+		scan_level(i);
+		ScanEntry *s = &scan[i];
+		if (s->level == 0)
 			continue;
+//printf("pid %d level %u  parent %d\n", s->pid, s->level, s->parent);
+
+		Process *p = pid_find(s->pid);
+		if (p && p->start_time != s->start_time) {
+			// pid recycled
+			pid_remove(s->pid);
+			p = NULL;
 		}
+		if (!p)
+			p = pid_add(s->pid);
+		p->level = s->level;
+		p->parent = s->parent;
+		p->first_child = 0;
+		p->next_sibling = 0;
+		p->utime = 0;
+		p->stime = 0;
+		p->rss = 0;
+		p->shared = 0;
+		p->rx = 0;
+		p->tx = 0;
+		p->proc_utime = s->utime;
+		p->proc_stime = s->stime;
+		p->proc_minflt = s->minflt;
+		p->proc_majflt = s->majflt;
+		p->proc_rss = 0;
+		p->proc_shared = 0;
+		p->start_time = s->start_time;
+		p->seen = true;
+
+		// the user is needed only for the main firejail process
+		ProcSnapshot snap;
+		if (p->level == 1 && pid_snapshot(p->pid, &snap, SNAP_STATUS) == 0)
+			p->uid = snap.uid;
+	}
+	for (i = pids_cnt - 1; i >= 0; i--) {
+		if (!pids[i].seen)
+			pid_remove(pids[i].pid);
+	}
 
-		memset(&pids_data[pid], 0, sizeof(ProcessData));
+	// build the children lists; walking the process list backwards keeps the children in /proc order
+	for (i = scan_cnt - 1; i >= 0; i--) {
+		if (scan[i].level <= 1)
+			continue;
+		Process *p = pid_find(scan[i].pid);
+		Process *parent = pid_find(scan[i].parent);
+		assert(p && parent);
+		p->next_sibling = parent->first_child;
+		parent->first_child = p->pid;
+	}
+}
 
-		// look for firejail executable name
-		char buf[PIDS_BUFLEN];
-		while (fgets(buf, PIDS_BUFLEN - 1, fp)) {
-			if (strncmp(buf, "Name:", 5) == 0) {
-				char *ptr = buf + 5;
-				while (*ptr != '\0' && (*ptr == ' ' || *ptr == '\t')) {
-					ptr++;
-				}
-				if (*ptr == '\0') {
-					fprintf(stderr, "Error: cannot read /proc file\n");
-					exit(1);
-				}
-
-				if ((strncmp(ptr, "firejail", 8) == 0) && (mon_pid == 0 || mon_pid == pid)) {
-					if (pid_proc_cmdline_x11_xpra_xephyr(pid))
-						pids[pid].level = 0;
-					else {
-						pids[pid].level = 1;
-						if (pids_first == 0)
-							pids_first = pid;
-					}
-				}
-				else
-					pids[pid].level = 0;
-			}
-			if (strncmp(buf, "State:", 6) == 0) {
-				if (strstr(buf, "(zombie)"))
-					pids[pid].level = 0;
-			}
-			else if (strncmp(buf, "PPid:", 5) == 0) {
-				char *ptr = buf + 5;
-				while (*ptr != '\0' && (*ptr == ' ' || *ptr == '\t')) {
-					ptr++;
-				}
-				if (*ptr == '\0') {
-					fprintf(stderr, "Error: cannot read /proc file\n");
-					exit(1);
-				}
-				unsigned parent = atoi(ptr);
-				parent %= max_pids;
-				pids_data[pid].parent = parent;
-				if (pids[parent].level > 0)
-					pids[pid].level = (pids[parent].level == UCHAR_MAX)? UCHAR_MAX:  pids[parent].level + 1;
-//if (pids[pid].level)
-//printf("pid %d level %u  parent %d\n", pid, pids[pid].level, pids_data[pid].parent);
-			}
-			else if (strncmp(buf, "Uid:", 4) == 0) {
-				if (pids[pid].level > 0) {
-					char *ptr = buf + 5;
-					while (*ptr != '\0' && (*ptr == ' ' || *ptr == '\t')) {
-						ptr++;
-					}
-					if (*ptr == '\0') {
-						fprintf(stderr, "Error: cannot read /proc file\n");
-						exit(1);
-					}
-					pids_data[pid].uid = atoi(ptr);
-				}
-				break;
-			}
-		}
-		fclose(fp);
-		free(file);
+// link the process at the end of the children list of its parent
+static void pid_link(Process *p) {
+	Process *parent = pid_find(p->parent);
+	if (!parent)
+		return;
+	if (!parent->first_child) {
+		parent->first_child = p->pid;
+		return;
 	}
-	closedir(dir);
+
+	Process *last = pid_find(parent->first_child);
+	while (last->next_sibling)
+		last = pid_find(last->next_sibling);
+	last->next_sibling = p->pid;
+}
+
+// remove the process from the children list of its parent
+static void pid_unlink(Process *p) {
+	Process *parent = pid_find(p->parent);
+	if (!parent)
+		return;
+	if (parent->first_child == p->pid) {
+		parent->first_child = p->next_sibling;
+		return;
+	}
+
+	Process *prev = pid_find(parent->first_child);
+	while (prev && prev->next_sibling != p->pid)
+		prev = pid_find(prev->next_sibling);
+	if (prev)
+		prev->next_sibling = p->next_sibling;
+}
+
+// add a new process to pids array
+static Process *pid_insert(pid_t pid, unsigned char level, ProcSnapshot *snap) {
+	Process *p = pid_add(pid);
+	p->level = level;
+	p->parent = snap->parent;
+	p->proc_utime = snap->utime;
+	p->proc_stime = snap->stime;
+	p->proc_minflt = snap->minflt;
+	p->proc_majflt = snap->majflt;
+	p->start_time = snap->start_time;
+	p->seen = true;
+	pid_link(p);
+	return p;
+}
+
+// a new process was forked; it belongs to a sandbox if its parent does
+int pid_event_fork(pid_t pid) {
+	if (pid_find(pid))
+		return 0;
+
+	ProcSnapshot snap;
+	if (pid_snapshot(pid, &snap, SNAP_STAT))
+		return 0;	// already gone
+	Process *parent = pid_find(snap.parent);
+	if (!parent)
+		return 0;
+
+	unsigned char level = (parent->level == LEVEL_MAX)? LEVEL_MAX: parent->level + 1;
+	pid_insert(pid, level, &snap);
+	return 0;
+}
+
+// a process started a new program; look for new firejail sandboxes
+int pid_event_exec(pid_t pid) {
+	if (pid_find(pid) || pid == getpid())
+		return 0;
+
+	ProcSnapshot snap;
+	if (pid_snapshot(pid, &snap, SNAP_STAT))
+		return 0;	// already gone
+	if (snap.state == 'Z' || strncmp(snap.name, "firejail", 8) != 0 ||
+	    pid_proc_cmdline_x11_xpra_xephyr(pid, snap.name))
+		return 0;
+
+	Process *p = pid_insert(pid, 1, &snap);
+	if (pid_snapshot(pid, &snap, SNAP_STATUS) == 0)
+		p->uid = snap.uid;
+	return 0;
+}
+
+// a process terminated
+int pid_event_exit(pid_t pid) {
+	Process *p = pid_find(pid);
+	if (!p)
+		return 0;
+
+	// the kernel moves the children to a new parent without sending an event
+	int rv = (p->first_child)? 1: 0;
+	pid_unlink(p);
+	pid_remove(pid);
+	return rv;
+}
+
+// next process in a preorder walk of the process tree starting at root; returns NULL at the end of the walk
+static inline Process *pid_walk_next(Process *root, Process *p) {
+	if (p->first_child)
+		return pid_find(p->first_child);
+	while (p && p != root) {
+		if (p->next_sibling)
+			return pid_find(p->next_sibling);
+		p = pid_find(p->parent);
+	}
+	return NULL;
 }
 
 // return 1 if error
@@ -448,115 +1063,467 @@ char *pid_proc_cmdline(const pid_t pid) {
 }
 
 
-// recursivity!!!
+// update the process with the new content of stat and statm files, NULL if the file could not be read
+static void pid_update_process(Process *p, const char *statbuf, const char *statmbuf) {
+	ProcSnapshot snap;
+	if (statbuf && statmbuf &&
+	    parse_stat(statbuf, &snap) == 0 &&
+	    snap.start_time == p->start_time &&
+	    parse_statm(statmbuf, &snap) == 0) {
+		p->proc_utime = snap.utime;
+		p->proc_stime = snap.stime;
+		p->proc_minflt = snap.minflt;
+		p->proc_majflt = snap.majflt;
+		p->proc_rss = snap.rss;
+		p->proc_shared = snap.shared;
+	}
+	else {
+		// process terminated
+		pid_close_fds(p);
+		p->proc_utime = 0;
+		p->proc_stime = 0;
+		p->proc_minflt = 0;
+		p->proc_majflt = 0;
+		p->proc_rss = 0;
+		p->proc_shared = 0;
+	}
+}
+
+static void pid_refresh_process(Process *p) {
+	char statbuf[PIDS_BUFLEN];
+	char statmbuf[PIDS_BUFLEN];
+	bool ok = pid_pread_file(p, &p->stat_fd, "stat", statbuf, sizeof(statbuf)) != -1 &&
+		pid_pread_file(p, &p->statm_fd, "statm", statmbuf, sizeof(statmbuf)) != -1;
+	pid_update_process(p, (ok)? statbuf: NULL, (ok)? statmbuf: NULL);
+}
+
+// read again cpu and memory data for all the processes in the sandbox
+void pid_refresh_sandbox(unsigned pid) {
+	Process *root = pid_find(pid);
+	Process *p;
+	for (p = root; p; p = pid_walk_next(root, p))
+		pid_refresh_process(p);
+}
+
+#ifdef HAVE_IO_URING
+// io_uring ring, set up on first use; all the reads for a cycle are queued in a single submission
+#define URING_ENTRIES 256
+#define URING_STAT_BUFLEN 2048
+#define URING_STATM_BUFLEN 256
+#define URING_RETRIES 8		// io_uring_enter calls failing with EINTR, EAGAIN or EBUSY
+static struct {
+	int fd;			// -1 not initialized, -2 not available
+	unsigned entries;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+} uring = { -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+static char *uring_buf = 0;	// URING_STAT_BUFLEN + URING_STATM_BUFLEN bytes for each process
+static int uring_buf_cnt = 0;
+static int *uring_res = 0;	// two results for each process, stat and statm
+
+static bool pid_uring_init(void) {
+	if (uring.fd != -1)
+		return uring.fd >= 0;
+	uring.fd = -2;
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+	if (fd < 0)
+		return false;	// ENOSYS, or disabled with kernel.io_uring_disabled
+
+	size_t sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cq_len > sq_len)
+			sq_len = cq_len;
+		cq_len = sq_len;
+	}
+
+	char *sq_ptr = (char *) mmap(0, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+	char *cq_ptr = sq_ptr;
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+		cq_ptr = (char *) mmap(0, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED) {
+			munmap(sq_ptr, sq_len);
+			close(fd);
+			return false;
+		}
+	}
+	void *sqes = mmap(0, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		munmap(sq_ptr, sq_len);
+		if (cq_ptr != sq_ptr)
+			munmap(cq_ptr, cq_len);
+		close(fd);
+		return false;
+	}
+
+	uring.entries = params.sq_entries;
+	uring.sq_head = (unsigned *) (sq_ptr + params.sq_off.head);
+	uring.sq_tail = (unsigned *) (sq_ptr + params.sq_off.tail);
+	uring.sq_mask = (unsigned *) (sq_ptr + params.sq_off.ring_mask);
+	uring.sq_array = (unsigned *) (sq_ptr + params.sq_off.array);
+	uring.sqes = (struct io_uring_sqe *) sqes;
+	uring.cq_head = (unsigned *) (cq_ptr + params.cq_off.head);
+	uring.cq_tail = (unsigned *) (cq_ptr + params.cq_off.tail);
+	uring.cq_mask = (unsigned *) (cq_ptr + params.cq_off.ring_mask);
+	uring.cqes = (struct io_uring_cqe *) (cq_ptr + params.cq_off.cqes);
+	uring.fd = fd;
+	return true;
+}
+
+// collect the completions available in the ring; returns the number of completions
+static unsigned pid_uring_reap(int *res) {
+	unsigned head = *uring.cq_head;
+	unsigned cnt = 0;
+	while (head != __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE)) {
+		struct io_uring_cqe *cqe = &uring.cqes[head & *uring.cq_mask];
+		res[cqe->user_data] = cqe->res;
+		head++;
+		cnt++;
+	}
+	__atomic_store_n(uring.cq_head, head, __ATOMIC_RELEASE);
+	return cnt;
+}
+
+// queue n reads and wait for all of them; returns 0 if ok, or the error number of the failed
+// io_uring_enter call; the ring is left empty and can be used again, unless EIO is returned
+static int pid_uring_submit(int *fds, char **bufs, unsigned *lens, int *res, unsigned n) {
+	unsigned tail = *uring.sq_tail;
+	unsigned mask = *uring.sq_mask;
+	unsigned i;
+	for (i = 0; i < n; i++) {
+		unsigned index = tail & mask;
+		struct io_uring_sqe *sqe = &uring.sqes[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = fds[i];
+		sqe->addr = (unsigned long) bufs[i];
+		sqe->len = lens[i] - 1;
+		sqe->off = 0;
+		sqe->user_data = i;
+		uring.sq_array[index] = index;
+		tail++;
+	}
+	__atomic_store_n(uring.sq_tail, tail, __ATOMIC_RELEASE);
+
+	// on a short submit the kernel leaves the rest of the entries in the queue, and they are
+	// submitted again in the next call, together with the wait for the completions
+	unsigned queued = n;
+	unsigned inflight = 0;
+	unsigned cnt = 0;
+	int retries = 0;
+	int err = 0;
+	while (cnt < n) {
+		int rv = syscall(__NR_io_uring_enter, uring.fd, queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (rv < 0) {
+			err = errno;
+			// EAGAIN and EBUSY: the completions already posted are collected below, and the
+			// kernel has room again for the next call
+			if ((err != EINTR && err != EAGAIN && err != EBUSY) || ++retries > URING_RETRIES)
+				break;
+		}
+		else {
+			queued -= rv;
+			inflight += rv;
+		}
+
+		unsigned done = pid_uring_reap(res);
+		cnt += done;
+		inflight -= done;
+	}
+	if (cnt == n)
+		return 0;
+
+	// give up: the entries still queued are dropped, and the reads already submitted are waited for,
+	// since they write in the caller's buffers
+	__atomic_store_n(uring.sq_tail, __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+	while (inflight) {
+		if (syscall(__NR_io_uring_enter, uring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+		    errno != EINTR && errno != EAGAIN && errno != EBUSY)
+			return EIO;	// the state of the ring is unknown
+		inflight -= pid_uring_reap(res);
+	}
+	return err;
+}
+
+// read stat and statm for all the processes in pids array using io_uring; returns 0 if ok,
+// or an error number
+static int pid_refresh_uring(void) {
+	if (!pid_uring_init())
+		return ENOSYS;
+
+	if (uring_buf_cnt < pids_cnt) {
+		uring_buf_cnt = pids_cnt * 2;
+		free(uring_buf);
+		free(uring_res);
+		uring_buf = (char *) malloc((size_t) uring_buf_cnt * (URING_STAT_BUFLEN + URING_STATM_BUFLEN));
+		uring_res = (int *) malloc(sizeof(int) * uring_buf_cnt * 2);
+		if (!uring_buf || !uring_res)
+			errExit("malloc");
+	}
+
+	// open the files; without a descriptor, the process is read the old way
+	int i;
+	for (i = 0; i < pids_cnt; i++) {
+		Process *p = &pids[i];
+		uring_res[2 * i] = uring_res[2 * i + 1] = -EBADF;
+		if (p->stat_fd == -1 && pid_fd_available() && (p->stat_fd = pid_open_file(p->pid, "stat")) != -1)
+			fds_cnt++;
+		if (p->statm_fd == -1 && pid_fd_available() && (p->statm_fd = pid_open_file(p->pid, "statm")) != -1)
+			fds_cnt++;
+	}
+
+	// queue the reads, URING_ENTRIES at a time
+	int fds[URING_ENTRIES];
+	char *bufs[URING_ENTRIES];
+	unsigned lens[URING_ENTRIES];
+	int index[URING_ENTRIES];	// position in uring_res
+	int res[URING_ENTRIES];
+	unsigned n = 0;
+	for (i = 0; i <= pids_cnt; i++) {
+		if (i < pids_cnt && pids[i].stat_fd != -1 && pids[i].statm_fd != -1) {
+			char *buf = uring_buf + (size_t) i * (URING_STAT_BUFLEN + URING_STATM_BUFLEN);
+			fds[n] = pids[i].stat_fd;
+			bufs[n] = buf;
+			lens[n] = URING_STAT_BUFLEN;
+			index[n++] = 2 * i;
+			fds[n] = pids[i].statm_fd;
+			bufs[n] = buf + URING_STAT_BUFLEN;
+			lens[n] = URING_STATM_BUFLEN;
+			index[n++] = 2 * i + 1;
+		}
+
+		if (n && (n + 2 > uring.entries || n + 2 > URING_ENTRIES || i == pids_cnt)) {
+			int err = pid_uring_submit(fds, bufs, lens, res, n);
+			if (err)
+				return err;
+			unsigned j;
+			for (j = 0; j < n; j++) {
+				// old kernels without IORING_OP_READ
+				if (res[j] == -EINVAL)
+					return EINVAL;
+				uring_res[index[j]] = res[j];
+			}
+			n = 0;
+		}
+	}
+
+	// update the processes
+	for (i = 0; i < pids_cnt; i++) {
+		Process *p = &pids[i];
+		if (uring_res[2 * i] == -EBADF) {
+			pid_refresh_process(p);
+			continue;
+		}
+
+		char *buf = uring_buf + (size_t) i * (URING_STAT_BUFLEN + URING_STATM_BUFLEN);
+		int statlen = uring_res[2 * i];
+		int statmlen = uring_res[2 * i + 1];
+		if (statlen > 0)
+			buf[statlen] = '\0';
+		if (statmlen > 0)
+			buf[URING_STAT_BUFLEN + statmlen] = '\0';
+		pid_update_process(p, (statlen > 0)? buf: NULL, (statmlen > 0)? buf + URING_STAT_BUFLEN: NULL);
+	}
+
+	return 0;
+}
+#endif
+
+// read again cpu and memory data for all the processes in pids array;
+// io_uring is used if available, in order to read all the files at about the same time
+void pid_refresh_all(void) {
+#ifdef HAVE_IO_URING
+	int err = pid_refresh_uring();
+	if (err == 0)
+		return;
+	// fall back on regular reads; io_uring is disabled only if the kernel cannot run our reads,
+	// after other errors the ring is used again in the next cycle
+	if (uring.fd >= 0 && (err == ENOSYS || err == EINVAL || err == EOPNOTSUPP || err == EPERM || err == EIO)) {
+		close(uring.fd);
+		uring.fd = -2;
+	}
+#endif
+	int i;
+	for (i = 0; i < pids_cnt; i++)
+		pid_refresh_process(&pids[i]);
+}
+
 void pid_get_cpu_sandbox(unsigned pid, unsigned *utime, unsigned *stime) {
-//printf("call %d, last %d\n", pid, pids_last);
-	if (pids[pid].level == 1) {
+	Process *root = pid_find(pid);
+	if (!root || root->level == 1) {
 		*utime = 0;
 		*stime = 0;
 	}
 
-	unsigned utmp = 0;
-	unsigned stmp = 0;
-	pid_get_cpu_time(pid, &utmp, &stmp);
-	*utime += utmp;
-	*stime += stmp;
-
-	int i;
-	for (i = pid + 1; i < (pids_last + 1); i++) {
-		if (pids_data[i].parent == (int) pid)
-			pid_get_cpu_sandbox(i, utime, stime);
+	Process *p;
+	for (p = root; p; p = pid_walk_next(root, p)) {
+		*utime += p->proc_utime;
+		*stime += p->proc_stime;
 	}
 }
 
 void pid_get_mem_sandbox(unsigned pid, unsigned *rss, unsigned *shared) {
-	if (pids[pid].level == 1) {
+	Process *root = pid_find(pid);
+	if (!root || root->level == 1) {
 		*rss = 0;
 		*shared = 0;
 	}
 
-	pid_getmem(pid, rss, shared);
-
-	int i;
-	for (i = pid + 1; i < (pids_last + 1); i++) {
-		if (pids_data[i].parent == (int) pid)
-			pid_get_mem_sandbox(i, rss, shared);
+	Process *p;
+	for (p = root; p; p = pid_walk_next(root, p)) {
+		*rss += p->proc_rss;
+		*shared += p->proc_shared;
 	}
 }
 
-#define MAXBUF PIDS_BUFLEN
-void pid_get_netstats_sandbox(int parent, unsigned long long *rx, unsigned long long *tx) {
-	*rx = 0;
-	*tx = 0;
+void pid_get_faults_sandbox(unsigned pid, unsigned long long *minflt, unsigned long long *majflt) {
+	*minflt = 0;
+	*majflt = 0;
 
-	// find the first child
-	int child = -1;
-	if (parent == 1)
-		child = 1;
-	else {
-		for (child = parent + 1; child < (pids_last + 1); child++) {
-			if (pids_data[child].parent == parent)
-				break;
-		}
+	Process *root = pid_find(pid);
+	Process *p;
+	for (p = root; p; p = pid_walk_next(root, p)) {
+		*minflt += p->proc_minflt;
+		*majflt += p->proc_majflt;
 	}
-	if (child == -1)
-		return;
-
-	// open /proc/child/net/dev file and read rx and tx
-	char *fname;
-	if (asprintf(&fname, "/proc/%d/net/dev", child) == -1)
-		errExit("asprintf");
+}
 
-	FILE *fp = fopen(fname, "r");
-	if (!fp) {
-		free(fname);
-		return;
+// smaps_rollup walks all the memory mappings of the process in the kernel, it is a lot slower than statm
+void pid_get_smaps_sandbox(unsigned pid, unsigned *pss, unsigned *uss, unsigned *swap) {
+	*pss = 0;
+	*uss = 0;
+	*swap = 0;
+
+	Process *root = pid_find(pid);
+	Process *p;
+	for (p = root; p; p = pid_walk_next(root, p)) {
+		ProcSnapshot snap;
+		if (pid_snapshot(p->pid, &snap, SNAP_SMAPS))
+			continue;
+		*pss += snap.pss;
+		*uss += snap.private_clean + snap.private_dirty;
+		*swap += snap.swap;
 	}
+}
 
-	char buf[MAXBUF];
-	while (fgets(buf, MAXBUF, fp)) {
-		if (strncmp(buf, "Inter", 5) == 0)
+// storage I/O counters summed over all the processes in the sandbox
+void pid_get_io_sandbox(unsigned pid, unsigned long long *read_bytes, unsigned long long *write_bytes,
+	unsigned long long *syscr, unsigned long long *syscw) {
+	*read_bytes = 0;
+	*write_bytes = 0;
+	*syscr = 0;
+	*syscw = 0;
+
+	Process *root = pid_find(pid);
+	Process *p;
+	for (p = root; p; p = pid_walk_next(root, p)) {
+		ProcSnapshot snap;
+		if (pid_snapshot(p->pid, &snap, SNAP_IO))
 			continue;
-		if (strncmp(buf, " face", 5) == 0)
+		*read_bytes += snap.read_bytes;
+		*write_bytes += snap.write_bytes;
+		*syscr += snap.syscr;
+		*syscw += snap.syscw;
+	}
+}
+
+// scheduler counters summed over all the processes in the sandbox
+void pid_get_sched_sandbox(unsigned pid, unsigned long long *run_delay, unsigned long long *vcsw, unsigned long long *nvcsw) {
+	*run_delay = 0;
+	*vcsw = 0;
+	*nvcsw = 0;
+
+	Process *root = pid_find(pid);
+	Process *p;
+	for (p = root; p; p = pid_walk_next(root, p)) {
+		ProcSnapshot snap;
+		if (pid_snapshot(p->pid, &snap, SNAP_STATUS | SNAP_SCHED))
 			continue;
+		*run_delay += snap.run_delay;
+		*vcsw += snap.vcsw;
+		*nvcsw += snap.nvcsw;
+	}
+}
 
-		char *ptr = buf;
-		while (*ptr != '\0' && *ptr != ':') {
-			ptr++;
-		}
+// cgroup v2 directory of the process; returns allocated memory, NULL if not found
+char *pid_get_cgroup(pid_t pid) {
+	char buf[PIDS_BUFLEN];
+	if (pid_read_file(pid, "cgroup", buf, sizeof(buf)) == -1)
+		return NULL;
 
-		if (*ptr == '\0') {
-			fclose(fp);
-			free(fname);
-			return;
-		}
+	// the unified hierarchy is reported on a "0::/path" line
+	const char *ptr = (strncmp(buf, "0::", 3) == 0)? buf: strstr(buf, "\n0::");
+	if (!ptr)
+		return NULL;
+	if (*ptr == '\n')
 		ptr++;
+	ptr += 3;
+	const char *end = strchr(ptr, '\n');
+	int len = (end)? end - ptr: (int) strlen(ptr);
 
-		long long unsigned rxval;
-		long long unsigned txval;
-		unsigned a, b, c, d, e, f, g;
-		int rv = sscanf(ptr, "%llu %u %u %u %u %u %u %u %llu",
-			&rxval, &a, &b, &c, &d, &e, &f, &g, &txval);
-		if (rv == 9) {
-			*rx += rxval;
-			*tx += txval;
-		}
+	char *rv;
+	if (asprintf(&rv, "/sys/fs/cgroup%.*s", len, ptr) == -1)
+		errExit("asprintf");
+	return rv;
+}
+
+// read the "some" total stall time from a pressure file; returns 1 if error
+static int pid_read_pressure_file(const char *fname, unsigned long long *total) {
+	char buf[PIDS_BUFLEN];
+	int fd = open(fname, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return 1;
+	ssize_t rv = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (rv <= 0)
+		return 1;
+	buf[rv] = '\0';
+
+	if (strncmp(buf, "some ", 5) != 0)
+		return 1;
+	return parse_key(buf, "total=", total);
+}
+
+int pid_get_pressure(const char *cgroup, PressureStall *ps) {
+	memset(ps, 0, sizeof(PressureStall));
+	char fname[PATH_MAX];
+	const char *names[3] = { "cpu", "memory", "io" };
+	unsigned long long *totals[3] = { &ps->cpu, &ps->memory, &ps->io };
+	int i;
+	int found = 0;
+	for (i = 0; i < 3; i++) {
+		if (cgroup)
+			snprintf(fname, sizeof(fname), "%s/%s.pressure", cgroup, names[i]);
+		else
+			snprintf(fname, sizeof(fname), "/proc/pressure/%s", names[i]);
+		if (pid_read_pressure_file(fname, totals[i]) == 0)
+			found++;
 	}
 
-	free(fname);
-	fclose(fp);
-	return;
+	return (found)? 0: 1;
 }
 
 // return 1 if firejail --x11 on command line
-static int pid_proc_cmdline_x11_xpra_xephyr(const pid_t pid) {
+static int pid_proc_cmdline_x11_xpra_xephyr(const pid_t pid, const char *comm) {
 	// if comm is not firejail return 0
-	char *comm = pid_proc_comm(pid);
-	if (strcmp(comm, "firejail") != 0) {
-		free(comm);
+	if (strcmp(comm, "firejail") != 0)
 		return 0;
-	}
-	free(comm);
 
 	// open /proc/pid/cmdline file
 	char *fname;
@@ -612,34 +1579,34 @@ static int pid_proc_cmdline_x11_xpra_xephyr(const pid_t pid) {
 // dbus proxy path used by firejail and firemon
 #define XDG_DBUS_PROXY_PATH "/usr/bin/xdg-dbus-proxy"
 int pid_find_child(int id) {
-	int i;
+	Process *p = pid_find(id);
+	if (!p)
+		return -1;
+
 	int first_child = -1;
 	// find the first child
-	for (i = 0; i < max_pids && first_child == -1; i++) {
-		if (pids[i].level == 2 && pids_data[i].parent == id) {
-			// skip /usr/bin/xdg-dbus-proxy (started by firejail for dbus filtering)
-			char *cmdline = pid_proc_cmdline(i);
-			if (strncmp(cmdline, XDG_DBUS_PROXY_PATH, strlen(XDG_DBUS_PROXY_PATH)) == 0) {
-				free(cmdline);
-				continue;
-			}
+	pid_t i;
+	for (i = p->first_child; i; i = pid_find(i)->next_sibling) {
+		// skip /usr/bin/xdg-dbus-proxy (started by firejail for dbus filtering)
+		char *cmdline = pid_proc_cmdline(i);
+		if (cmdline && strncmp(cmdline, XDG_DBUS_PROXY_PATH, strlen(XDG_DBUS_PROXY_PATH)) == 0) {
 			free(cmdline);
-			first_child = i;
-			break;
+			continue;
 		}
+		free(cmdline);
+		first_child = i;
+		break;
 	}
 
 	if (first_child == -1)
 		return -1;
 
 	// find the second-level child
-	for (i = 0; i < max_pids; i++) {
-		if (pids[i].level == 3 && pids_data[i].parent == first_child)
-			return i;
-	}
+	p = pid_find(first_child);
+	if (p->first_child)
+		return p->first_child;
 
 	// if a second child is not found, return the first child pid
 	// this happens for processes sandboxed with --join
 	return first_child;
 }
-
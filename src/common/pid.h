@@ -22,30 +22,92 @@
 #include "common.h"
 
 typedef struct {
+	pid_t pid;
 	unsigned char level;
-		 // 0 not a process, not firejail, or zombie process
 		 // 1 main firejail process
 		 // > 1 firejail child
-} Process;
-
-typedef struct {
 	pid_t parent;
-	uid_t uid;
+	pid_t first_child;	// 0 if no children
+	pid_t next_sibling;	// 0 if this is the last child
+	uid_t uid;		// main firejail process only
+
+	// sandbox values, set by the caller in the main firejail process
 	unsigned utime;
 	unsigned stime;
 	unsigned rss;
 	unsigned shared;
 	unsigned long long rx;	// network rx, bytes
 	unsigned long long tx;	// networking tx, bytes
-} ProcessData;
+	unsigned pss;		// KiB, from smaps_rollup
+	unsigned uss;		// KiB, from smaps_rollup
+	unsigned swap;		// KiB, from smaps_rollup
+	unsigned long long read_bytes;	// storage I/O, bytes
+	unsigned long long write_bytes;
+	unsigned long long syscr;	// read and write syscalls
+	unsigned long long syscw;
+	unsigned long long run_delay;	// runqueue wait, nanoseconds
+	unsigned long long vcsw;	// context switches
+	unsigned long long nvcsw;
+	unsigned long long minflt;	// page faults
+	unsigned long long majflt;
+	unsigned long long psi_cpu;	// cgroup pressure stall time, microseconds
+	unsigned long long psi_memory;
+	unsigned long long psi_io;
+
+	// values for this process only, from the last snapshot
+	unsigned proc_utime;
+	unsigned proc_stime;
+	unsigned long long proc_minflt;
+	unsigned long long proc_majflt;
+	unsigned proc_rss;	// pages
+	unsigned proc_shared;	// pages
+	unsigned long long start_time;
+	bool seen;		// found by the last pid_read() scan
 
-extern int max_pids;
+	// /proc/pid/stat and /proc/pid/statm kept open by pid_refresh_sandbox(), -1 if closed
+	int stat_fd;
+	int statm_fd;
+} Process;
+
+// sandboxed processes, in no particular order
 extern Process *pids;
-extern ProcessData *pids_data;
-extern int pids_first;
-extern int pids_last;
+extern int pids_cnt;
+
+// process data extracted from /proc/pid files in a single pass
+#define SNAP_STAT	0x01	// /proc/pid/stat: name, state, parent, page faults, cpu times, start time
+#define SNAP_STATM	0x02	// /proc/pid/statm: rss, shared
+#define SNAP_STATUS	0x04	// /proc/pid/status: uid, context switches
+#define SNAP_SMAPS	0x08	// /proc/pid/smaps_rollup: pss, private, swap
+#define SNAP_IO		0x10	// /proc/pid/io: storage bytes and read/write syscalls
+#define SNAP_SCHED	0x20	// /proc/pid/schedstat: runqueue wait time
+typedef struct {
+	char name[16];	// executable name, truncated by the kernel to 15 characters
+	char state;	// R, S, D, Z, ...
+	pid_t parent;
+	uid_t uid;	// real user id
+	unsigned long long minflt;
+	unsigned long long majflt;
+	unsigned utime;
+	unsigned stime;
+	unsigned rss;	// pages
+	unsigned shared;	// pages
+	unsigned long long start_time;
+	unsigned pss;		// KiB
+	unsigned private_clean;	// KiB
+	unsigned private_dirty;	// KiB
+	unsigned swap;		// KiB
+	unsigned long long read_bytes;
+	unsigned long long write_bytes;
+	unsigned long long syscr;
+	unsigned long long syscw;
+	// the kernel reports the scheduler values for the main thread of the process
+	unsigned long long run_delay;	// nanoseconds spent waiting on a runqueue
+	unsigned long long vcsw;	// voluntary context switches
+	unsigned long long nvcsw;	// nonvoluntary context switches
+} ProcSnapshot;
 
 // pid self-contained functions
+int pid_snapshot(pid_t pid, ProcSnapshot *snap, int flags);
 void pid_getmem(unsigned pid, unsigned *rss, unsigned *shared);
 void pid_get_cpu_time(unsigned pid, unsigned *utime, unsigned *stime);
 unsigned long long pid_get_start_time(unsigned pid);
@@ -56,11 +118,44 @@ char *pid_proc_comm(const pid_t pid);
 char *pid_proc_cmdline(const pid_t pid);
 int pid_find_child(int id);
 
-// read all processes in pids array
+// find a sandboxed process in pids array; returns NULL if not found
+Process *pid_find(pid_t pid);
+
+// read all sandboxed processes in pids array
 void pid_read(pid_t mon_pid);
 
+// maximum number of threads used by pid_read(); the default is the number of CPUs
+void pid_set_scan_workers(int n);
+
+// update pids array incrementally, as reported by process events (pid_events.h);
+// a return value of 1 means pids array is out of sync and pid_read() should be called
+int pid_event_fork(pid_t pid);
+int pid_event_exec(pid_t pid);
+int pid_event_exit(pid_t pid);
+
+// read again cpu and memory data for all the processes in the sandbox;
+// the files stay open between calls, and they are read again with pread()
+void pid_refresh_sandbox(unsigned pid);
+// same for all the processes in pids array, using a single io_uring submission where available
+void pid_refresh_all(void);
 void pid_get_cpu_sandbox(unsigned pid, unsigned *utime, unsigned *stime);
+void pid_get_faults_sandbox(unsigned pid, unsigned long long *minflt, unsigned long long *majflt);
 void pid_get_mem_sandbox(unsigned pid, unsigned *rss, unsigned *shared);
-void pid_get_netstats_sandbox(int pid, unsigned long long *rx, unsigned long long *tx);
+// proportional set size, unique set size (private clean and dirty) and swap in KiB, read from smaps_rollup
+void pid_get_smaps_sandbox(unsigned pid, unsigned *pss, unsigned *uss, unsigned *swap);
+void pid_get_io_sandbox(unsigned pid, unsigned long long *read_bytes, unsigned long long *write_bytes,
+	unsigned long long *syscr, unsigned long long *syscw);
+void pid_get_sched_sandbox(unsigned pid, unsigned long long *run_delay, unsigned long long *vcsw, unsigned long long *nvcsw);
+
+// pressure stall information, "some" total stall time in microseconds
+typedef struct {
+	unsigned long long cpu;
+	unsigned long long memory;
+	unsigned long long io;
+} PressureStall;
+// cgroup v2 directory of the process; returns allocated memory, NULL if not found
+char *pid_get_cgroup(pid_t pid);
+// read /proc/pressure files, or the pressure files in cgroup directory; returns 1 if not available
+int pid_get_pressure(const char *cgroup, PressureStall *ps);
 
 #endif
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "common.h"
+#include "pid.h"
+#include "pid_events.h"
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+static int nl_fd = -1;
+
+// start or stop the event stream
+static int pid_events_subscribe(enum proc_cn_mcast_op op) {
+	char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))] __attribute__((aligned(NLMSG_ALIGNTO)));
+	memset(buf, 0, sizeof(buf));
+
+	struct nlmsghdr *nlh = (struct nlmsghdr *) buf;
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+	nlh->nlmsg_type = NLMSG_DONE;
+	nlh->nlmsg_pid = getpid();
+
+	struct cn_msg *cn = (struct cn_msg *) NLMSG_DATA(nlh);
+	cn->id.idx = CN_IDX_PROC;
+	cn->id.val = CN_VAL_PROC;
+	cn->len = sizeof(enum proc_cn_mcast_op);
+	memcpy(cn->data, &op, sizeof(op));
+
+	if (send(nl_fd, buf, nlh->nlmsg_len, 0) == -1)
+		return 1;
+	return 0;
+}
+
+int pid_events_open(void) {
+	if (nl_fd != -1)
+		return 0;
+
+	nl_fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_CONNECTOR);
+	if (nl_fd == -1)
+		return 1;
+
+	// joining the multicast group fails with EPERM without CAP_NET_ADMIN
+	struct sockaddr_nl addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+	addr.nl_pid = 0;
+	if (bind(nl_fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 ||
+	    pid_events_subscribe(PROC_CN_MCAST_LISTEN)) {
+		close(nl_fd);
+		nl_fd = -1;
+		return 1;
+	}
+
+	return 0;
+}
+
+void pid_events_close(void) {
+	if (nl_fd == -1)
+		return;
+	pid_events_subscribe(PROC_CN_MCAST_IGNORE);
+	close(nl_fd);
+	nl_fd = -1;
+}
+
+bool pid_events_active(void) {
+	return nl_fd != -1;
+}
+
+int pid_events_fd(void) {
+	return nl_fd;
+}
+
+// apply one event to pids array; returns PID_EVENTS_RESCAN if pids array is out of sync
+static int pid_events_apply(struct proc_event *ev) {
+	switch (ev->what) {
+		case proc_event::PROC_EVENT_FORK:
+			// threads are not tracked
+			if (ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid)
+				return pid_event_fork(ev->event_data.fork.child_tgid);
+			break;
+		case proc_event::PROC_EVENT_EXEC:
+			return pid_event_exec(ev->event_data.exec.process_tgid);
+		case proc_event::PROC_EVENT_EXIT:
+			if (ev->event_data.exit.process_pid == ev->event_data.exit.process_tgid)
+				return pid_event_exit(ev->event_data.exit.process_tgid);
+			break;
+		default:
+			break;
+	}
+	return PID_EVENTS_OK;
+}
+
+// read all the events queued in the socket
+static int pid_events_read(void) {
+	char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+	int rv = PID_EVENTS_OK;
+
+	while (1) {
+		struct sockaddr_nl addr;
+		socklen_t addrlen = sizeof(addr);
+		ssize_t len = recvfrom(nl_fd, buf, sizeof(buf), 0, (struct sockaddr *) &addr, &addrlen);
+		if (len == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return rv;
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS) {
+				// the socket buffer overflowed and some events were dropped
+				rv = PID_EVENTS_RESCAN;
+				continue;
+			}
+			close(nl_fd);
+			nl_fd = -1;
+			return PID_EVENTS_FAILED;
+		}
+
+		// accept messages only from the kernel
+		if (addr.nl_pid != 0)
+			continue;
+
+		struct nlmsghdr *nlh;
+		for (nlh = (struct nlmsghdr *) buf; NLMSG_OK(nlh, (size_t) len); nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_type == NLMSG_NOOP)
+				continue;
+			if (nlh->nlmsg_type == NLMSG_ERROR || nlh->nlmsg_type == NLMSG_OVERRUN) {
+				rv = PID_EVENTS_RESCAN;
+				continue;
+			}
+
+			struct cn_msg *cn = (struct cn_msg *) NLMSG_DATA(nlh);
+			if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC)
+				continue;
+			if (pid_events_apply((struct proc_event *) cn->data) == PID_EVENTS_RESCAN)
+				rv = PID_EVENTS_RESCAN;
+		}
+	}
+}
+
+static inline long long msec_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int pid_events_wait(int msec) {
+	if (nl_fd == -1)
+		return PID_EVENTS_FAILED;
+
+	int rv = PID_EVENTS_OK;
+	long long deadline = msec_now() + msec;
+	while (1) {
+		int rv2 = pid_events_read();
+		if (rv2 == PID_EVENTS_FAILED)
+			return rv2;
+		if (rv2 == PID_EVENTS_RESCAN)
+			rv = rv2;
+
+		long long timeout = deadline - msec_now();
+		if (timeout <= 0)
+			return rv;
+
+		struct pollfd pfd;
+		pfd.fd = nl_fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, (int) timeout) == -1 && errno != EINTR) {
+			pid_events_close();
+			return PID_EVENTS_FAILED;
+		}
+	}
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef PID_EVENTS_H
+#define PID_EVENTS_H
+
+// Process tracking using the netlink process connector. The kernel reports fork, exec and exit
+// events, and pids array (pid.h) is updated as they arrive. Subscribing to the connector requires
+// CAP_NET_ADMIN; without it the caller should fall back on reading /proc with pid_read() every cycle.
+
+// return 1 if the process connector is not available
+int pid_events_open(void);
+void pid_events_close(void);
+bool pid_events_active(void);
+// connector socket for callers running their own poll loop, -1 if not active
+int pid_events_fd(void);
+
+// wait up to msec milliseconds and apply the events to pids array
+#define PID_EVENTS_OK 0
+#define PID_EVENTS_RESCAN 1	// events were lost, call pid_read()
+#define PID_EVENTS_FAILED 2	// the connector stopped working and it was closed, call pid_read()
+int pid_events_wait(int msec);
+
+#endif
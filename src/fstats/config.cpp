@@ -71,6 +71,10 @@ void config_read_screen_size(int *x, int *y) {
 void config_write_screen_size(int x, int y) {
 	x = (x < MINSIZE)? DEFAULT_X_SIZE: x;
 	y = (y < MINSIZE)? DEFAULT_Y_SIZE: y;
+	int period = config_read_period();
+	int idle_period = config_read_idle_period();
+	int tier_1h = config_read_tier_1h();
+	int tier_12h = config_read_tier_12h();
 	
 	// open config file
 	char *cfgdir = get_config_directory();
@@ -84,8 +88,67 @@ void config_write_screen_size(int x, int y) {
 	if (!fp)
 		return;
 
-	// write file
+	// write file; the sampling periods and the tiers are set by hand, keep them
 	fprintf(fp, "x %d\n", x);
 	fprintf(fp, "y %d\n", y);
+	if (period != PERIOD_DEFAULT)
+		fprintf(fp, "period %d\n", period);
+	if (idle_period != IDLE_PERIOD_DEFAULT)
+		fprintf(fp, "idle-period %d\n", idle_period);
+	if (tier_1h != TIER_1H_DEFAULT)
+		fprintf(fp, "tier-1h %d\n", tier_1h);
+	if (tier_12h != TIER_12H_DEFAULT)
+		fprintf(fp, "tier-12h %d\n", tier_12h);
 	fclose(fp);
 }
+
+// read a "key N" line
+static int config_read_int(const char *key, int defval, int minval, int maxval) {
+	int val = defval;
+
+	// open config file
+	char *cfgdir = get_config_directory();
+	if (!cfgdir)
+		return val;
+	char *fname;
+	if (asprintf(&fname, "%s/fstats.config", cfgdir) == -1)
+		errExit("asprintf");
+	FILE *fp = fopen(fname, "r");
+	free(fname);
+	if (!fp)
+		return val;
+
+	// read file and parse it
+	int len = strlen(key);
+	char buf[BUFSIZE];
+	while (fgets(buf, BUFSIZE, fp)) {
+		char *ptr = buf;
+		while (*ptr == ' ' || *ptr == '\t')
+			ptr++;
+		if (strncmp(ptr, key, len) == 0 && ptr[len] == ' ') {
+			ptr += len + 1;
+			if (sscanf(ptr, "%d", &val) != 1 || val < minval || val > maxval) {
+				fprintf(stderr, "Error: invalid %s in ~/.config/firetools/fstats.config\n", key);
+				val = defval;
+			}
+		}
+	}
+	fclose(fp);
+	return val;
+}
+
+int config_read_period(void) {
+	return config_read_int("period", PERIOD_DEFAULT, PERIOD_MIN, PERIOD_MAX);
+}
+
+int config_read_idle_period(void) {
+	return config_read_int("idle-period", IDLE_PERIOD_DEFAULT, PERIOD_MIN, IDLE_PERIOD_MAX);
+}
+
+int config_read_tier_1h(void) {
+	return config_read_int("tier-1h", TIER_1H_DEFAULT, TIER_1H_MIN, TIER_1H_MAX);
+}
+
+int config_read_tier_12h(void) {
+	return config_read_int("tier-12h", TIER_12H_DEFAULT, TIER_12H_MIN, TIER_12H_MAX);
+}
@@ -17,70 +17,266 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
+#include <time.h>
 #include "db.h"
 
-Db::Db(): cycle_(DbPid::MAXCYCLE - 1), g1h_cycle_(DbPid::MAXCYCLE - 1), g1h_cycle_delta_(DbPid::G1HCYCLE_DELTA - 1), 
-	g12h_cycle_(DbPid::MAXCYCLE - 1), g12h_cycle_delta_(DbPid::G12HCYCLE_DELTA - 1), pidlist_(0) {}
+#define SLOTS_INIT 32
+#define HASH_INIT 64
+
+Db::Db(): cycle_(DbPid::MAXCYCLE - 1), g1h_cycle_(DbPid::MAXCYCLE - 1),
+	g12h_cycle_(DbPid::MAXCYCLE - 1), g12h_cycle_delta_(arg_tier_12h - 1),
+	slots_size_(SLOTS_INIT), slots_used_(0), free_cnt_(0), hash_(0), hash_size_(0), pid_cnt_(0),
+	first_(0), last_(0), snapshot_(0), epoch_(1), reader_epoch_(0), retired_(0) {
+	slots_ = (DbPid **) malloc(slots_size_ * sizeof(DbPid *));
+	free_ = (int *) malloc(slots_size_ * sizeof(int));
+	if (!slots_ || !free_)
+		errExit("malloc");
+	hashResize(HASH_INIT);
+	memset(time_, 0, sizeof(time_));
+}
 
 void Db::newCycle() {
 	if (++cycle_ >= DbPid::MAXCYCLE)
 		cycle_ = 0;
-	if (++g1h_cycle_delta_ >= DbPid::G1HCYCLE_DELTA) {
-		g1h_cycle_delta_ = 0;
-		if (++g1h_cycle_ >= DbPid::MAXCYCLE)
-			g1h_cycle_ = 0;
-		if (++g12h_cycle_delta_ >= DbPid::G12HCYCLE_DELTA) {
-			g12h_cycle_delta_ = 0;
-			if (++g12h_cycle_ >= DbPid::MAXCYCLE)
-				g12h_cycle_ = 0;
-		}
+	time_[GRAPH_1MIN][cycle_] = time(NULL);
+}
+
+// the sampling period changes when the window is hidden, the 1h entries follow the time sampled
+void Db::newG1HCycle() {
+	time_t now = time(NULL);
+	if (++g1h_cycle_ >= DbPid::MAXCYCLE)
+		g1h_cycle_ = 0;
+	time_[GRAPH_1H][g1h_cycle_] = now;
+	if (++g12h_cycle_delta_ >= arg_tier_12h) {
+		g12h_cycle_delta_ = 0;
+		if (++g12h_cycle_ >= DbPid::MAXCYCLE)
+			g12h_cycle_ = 0;
+		time_[GRAPH_12H][g12h_cycle_] = now;
 	}
 }
 
+// the history file keeps no entry times, they are spaced evenly back from the last update
+void Db::restoreCycles(int g1h_cycle, int g12h_cycle, int g12h_cycle_delta, time_t saved) {
+	if (g1h_cycle < 0 || g1h_cycle >= DbPid::MAXCYCLE ||
+	    g12h_cycle < 0 || g12h_cycle >= DbPid::MAXCYCLE ||
+	    g12h_cycle_delta < 0 || g12h_cycle_delta >= arg_tier_12h)
+		return;
+	g1h_cycle_ = g1h_cycle;
+	g12h_cycle_ = g12h_cycle;
+	g12h_cycle_delta_ = g12h_cycle_delta;
 
-DbPid *Db::findPid(pid_t pid) {
-	if (!pidlist_) {
-		return 0;
+	time_t t1h = saved;
+	time_t t12h = saved - (time_t) g12h_cycle_delta * arg_tier_1h;
+	for (int i = 0; i < DbPid::MAXCYCLE; i++) {
+		time_[GRAPH_1H][(g1h_cycle + DbPid::MAXCYCLE - i) % DbPid::MAXCYCLE] = t1h;
+		time_[GRAPH_12H][(g12h_cycle + DbPid::MAXCYCLE - i) % DbPid::MAXCYCLE] = t12h;
+		t1h -= arg_tier_1h;
+		t12h -= (time_t) arg_tier_1h * arg_tier_12h;
+	}
+}
+
+static inline unsigned hash_pid(pid_t pid, int size) {
+	unsigned h = (unsigned) pid * 2654435761u;
+	return (h ^ (h >> 16)) & (size - 1);
+}
+
+// index in hash_ table, -1 if not found
+int Db::hashFind(pid_t pid) {
+	for (unsigned i = hash_pid(pid, hash_size_); ; i = (i + 1) & (hash_size_ - 1)) {
+		if (hash_[i] == -1)
+			return -1;
+		if (slots_[hash_[i]]->pid_ == pid)
+			return i;
+	}
+}
+
+void Db::hashInsert(int slot) {
+	unsigned i = hash_pid(slots_[slot]->pid_, hash_size_);
+	while (hash_[i] != -1)
+		i = (i + 1) & (hash_size_ - 1);
+	hash_[i] = slot;
+}
+
+void Db::hashResize(int size) {
+	free(hash_);
+	hash_ = (int *) malloc(size * sizeof(int));
+	if (!hash_)
+		errExit("malloc");
+	hash_size_ = size;
+	for (int i = 0; i < size; i++)
+		hash_[i] = -1;
+	for (int i = 0; i < slots_used_; i++) {
+		if (slots_[i])
+			hashInsert(i);
 	}
-	
-	return pidlist_->find(pid);
+}
+
+DbPid *Db::findPid(pid_t pid) {
+	int index = hashFind(pid);
+	return (index == -1)? 0: slots_[hash_[index]];
 }
 
 DbPid *Db::newPid(pid_t pid) {
 	assert(findPid(pid) == 0);
-	
+
+	// find a slot
+	int slot;
+	if (free_cnt_)
+		slot = free_[--free_cnt_];
+	else {
+		if (slots_used_ == slots_size_) {
+			slots_size_ *= 2;
+			slots_ = (DbPid **) realloc(slots_, slots_size_ * sizeof(DbPid *));
+			free_ = (int *) realloc(free_, slots_size_ * sizeof(int));
+			if (!slots_ || !free_)
+				errExit("realloc");
+		}
+		slot = slots_used_++;
+	}
+
 	DbPid *newpid = new DbPid(pid);
-	if (!pidlist_)
-		pidlist_ = newpid;
+	newpid->slot_ = slot;
+	slots_[slot] = newpid;
+	if (++pid_cnt_ * 2 > hash_size_)
+		hashResize(hash_size_ * 2);
 	else
-		pidlist_->add(newpid);
-		
+		hashInsert(slot);
+
+	// add it at the end of the list
+	newpid->prev_ = last_;
+	if (last_)
+		last_->next_ = newpid;
+	else
+		first_ = newpid;
+	last_ = newpid;
+
 	return newpid;
 }
 
 DbPid *Db::removePid(pid_t pid) {
-	// find dbpid
-	DbPid *dbpid = findPid(pid);
-	if (!dbpid)
+	int i = hashFind(pid);
+	if (i == -1)
 		return 0;
-	
-	// remove first element
-	if (dbpid == pidlist_)
-		pidlist_ = dbpid->getNext();
+	DbPid *dbpid = slots_[hash_[i]];
+
+	// backward shift deletion: move up the entries in the same probe sequence
+	int mask = hash_size_ - 1;
+	hash_[i] = -1;
+	for (int j = (i + 1) & mask; hash_[j] != -1; j = (j + 1) & mask) {
+		int home = hash_pid(slots_[hash_[j]]->pid_, hash_size_);
+		// the entry stays if its home position is cyclically in (i, j]
+		bool stays = (i <= j)? (i < home && home <= j): (i < home || home <= j);
+		if (!stays) {
+			hash_[i] = hash_[j];
+			hash_[j] = -1;
+			i = j;
+		}
+	}
+
+	// release the slot
+	slots_[dbpid->slot_] = 0;
+	free_[free_cnt_++] = dbpid->slot_;
+	dbpid->slot_ = -1;
+	pid_cnt_--;
+
+	// unlink
+	if (dbpid->prev_)
+		dbpid->prev_->next_ = dbpid->next_;
 	else
-		pidlist_->remove(dbpid);
-	
-	dbpid->resetNext();
+		first_ = dbpid->next_;
+	if (dbpid->next_)
+		dbpid->next_->prev_ = dbpid->prev_;
+	else
+		last_ = dbpid->prev_;
+	dbpid->next_ = 0;
+	dbpid->prev_ = 0;
+
 	return dbpid;
 }
 
+DbSnapshot::DbSnapshot(int cycle, int g1h_cycle, int g12h_cycle, const time_t (*time)[DbPid::MAXCYCLE], DbPid *pidlist):
+	cycle_(cycle), g1h_cycle_(g1h_cycle), g12h_cycle_(g12h_cycle), pidlist_(pidlist),
+	retired_epoch_(0), retired_next_(0) {
+	memcpy(time_, time, sizeof(time_));
+}
+
+DbSnapshot::~DbSnapshot() {
+	DbPid *dbpid = pidlist_;
+	while (dbpid) {
+		DbPid *next = dbpid->getNext();
+		delete dbpid;
+		dbpid = next;
+	}
+}
+
+// the GUI looks up one sandbox for each page, a list walk is enough
+DbPid *DbSnapshot::findPid(pid_t pid) {
+	for (DbPid *dbpid = pidlist_; dbpid; dbpid = dbpid->getNext()) {
+		if (dbpid->getPid() == pid)
+			return dbpid;
+	}
+	return 0;
+}
+
+void Db::publish() {
+	// copy the pid list
+	DbPid *list = 0;
+	DbPid *tail = 0;
+	for (DbPid *dbpid = first_; dbpid; dbpid = dbpid->next_) {
+		DbPid *copy = new DbPid(*dbpid);
+		copy->prev_ = tail;
+		if (tail)
+			tail->next_ = copy;
+		else
+			list = copy;
+		tail = copy;
+	}
+	DbSnapshot *snap = new DbSnapshot(cycle_, g1h_cycle_, g12h_cycle_, time_, list);
+
+	// swap it in; the epoch is advanced after the swap, a reader entering the new epoch
+	// can only see the new snapshot
+	DbSnapshot *old = __atomic_exchange_n(&snapshot_, snap, __ATOMIC_SEQ_CST);
+	unsigned epoch = __atomic_add_fetch(&epoch_, 1, __ATOMIC_SEQ_CST);
+	if (old) {
+		old->retired_epoch_ = epoch;
+		old->retired_next_ = retired_;
+		retired_ = old;
+	}
+	reclaim();
+}
+
+// free the retired snapshots the reader cannot reach anymore
+void Db::reclaim() {
+	unsigned reader = __atomic_load_n(&reader_epoch_, __ATOMIC_SEQ_CST);
+	DbSnapshot **ptr = &retired_;
+	while (*ptr) {
+		DbSnapshot *snap = *ptr;
+		if (reader == 0 || reader >= snap->retired_epoch_) {
+			*ptr = snap->retired_next_;
+			delete snap;
+		}
+		else
+			ptr = &snap->retired_next_;
+	}
+}
+
+DbSnapshot *Db::acquire() {
+	assert(reader_epoch_ == 0);
+	__atomic_store_n(&reader_epoch_, __atomic_load_n(&epoch_, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+	return __atomic_load_n(&snapshot_, __ATOMIC_SEQ_CST);
+}
+
+void Db::release() {
+	__atomic_store_n(&reader_epoch_, 0, __ATOMIC_SEQ_CST);
+}
+
 void Db::dbgprint() {
-	if (pidlist_)
-		pidlist_->dbgprint();
+	for (DbPid *dbpid = first_; dbpid; dbpid = dbpid->next_)
+		dbpid->dbgprint();
 }
 
 void Db::dbgprintcycle() {
-	printf("4min cycle %d, 1h delta %d, 1h cycle %d, 12h delta %d, 12h cycle %d\n",
-		cycle_, g1h_cycle_delta_, g1h_cycle_, g12h_cycle_delta_, g12h_cycle_);
+	printf("1min cycle %d, 1h cycle %d, 12h delta %d, 12h cycle %d\n",
+		cycle_, g1h_cycle_, g12h_cycle_delta_, g12h_cycle_);
 }
 
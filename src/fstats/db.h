@@ -24,6 +24,46 @@
 #include "dbpid.h"
 
 
+// Immutable copy of the database at the end of a sampling cycle. The stats thread builds
+// a new snapshot every cycle, the GUI thread renders from it without taking any lock.
+class DbSnapshot {
+public:
+	DbSnapshot(int cycle, int g1h_cycle, int g12h_cycle, const time_t (*time)[DbPid::MAXCYCLE], DbPid *pidlist);
+	~DbSnapshot();
+
+	int getCycle() {
+		return cycle_;
+	}
+	int getG1HCycle() {
+		return g1h_cycle_;
+	}
+	int getG12HCycle() {
+		return g12h_cycle_;
+	}
+	// wall clock time of an entry in the 1min, 1h or 12h tier, 0 if the entry was never written
+	time_t getTime(GraphType gt, int cycle) {
+		assert(gt < GRAPH_ARCHIVE && cycle < DbPid::MAXCYCLE);
+		return time_[gt][cycle];
+	}
+	DbPid *firstPid() {
+		return pidlist_;
+	}
+	DbPid *findPid(pid_t pid);
+
+private:
+	DbSnapshot(DbSnapshot const&);
+	void operator=(DbSnapshot const&);
+	friend class Db;
+
+	int cycle_;
+	int g1h_cycle_;
+	int g12h_cycle_;
+	time_t time_[GRAPH_ARCHIVE][DbPid::MAXCYCLE];
+	DbPid *pidlist_;
+	unsigned retired_epoch_;	// epoch when the snapshot was replaced
+	DbSnapshot *retired_next_;
+};
+
 class Db {
 public:
 	static Db& instance() {
@@ -32,28 +72,36 @@ public:
 	}
 	
 	void newCycle();
+	// start a new 1h entry, called after one minute of samples
+	void newG1HCycle();
 	int getCycle() {
 		return cycle_;
 	}
 	int getG1HCycle() {
 		return g1h_cycle_;
 	}
-	int getG1HCycleDelta() {
-		return g1h_cycle_delta_;
-	}
 	int getG12HCycle() {
 		return g12h_cycle_;
 	}
 	int getG12HCycleDelta() {
 		return g12h_cycle_delta_;
 	}
+	// continue the 1h and 12h rings loaded from the history file, last updated at time saved
+	void restoreCycles(int g1h_cycle, int g12h_cycle, int g12h_cycle_delta, time_t saved);
+	// sandboxes in insertion order
 	DbPid *firstPid() {
-		return pidlist_;
+		return first_;
 	}
 	DbPid *newPid(pid_t pid);
 	DbPid *findPid(pid_t pid);
 	DbPid *removePid(pid_t pid);
 
+	// stats thread: publish a copy of the current cycle
+	void publish();
+	// GUI thread: the snapshot stays valid until release(); NULL if nothing was published yet
+	DbSnapshot *acquire();
+	void release();
+
 	void dbgprint();
 	void dbgprintcycle();
 		
@@ -61,14 +109,36 @@ private:
 	Db();
 	Db(Db const&);
 	void operator=(Db const&);
+	void reclaim();
+	int hashFind(pid_t pid);
+	void hashInsert(int slot);
+	void hashResize(int size);
 
 private:
 	int cycle_;
 	int g1h_cycle_;
-	int g1h_cycle_delta_;
 	int g12h_cycle_;
 	int g12h_cycle_delta_;
-	DbPid *pidlist_;
+	time_t time_[GRAPH_ARCHIVE][DbPid::MAXCYCLE];	// entry times for each tier
+
+	// sandbox registry: DbPid objects in a slot array, free slots are reused; the hash table maps pids
+	// to slots, open addressing with linear probing
+	DbPid **slots_;		// NULL for free slots
+	int slots_size_;
+	int slots_used_;	// slots taken at least once
+	int *free_;		// free slots stack
+	int free_cnt_;
+	int *hash_;		// slot number, -1 for empty entries
+	int hash_size_;		// power of 2, kept at least twice the number of sandboxes
+	int pid_cnt_;
+	DbPid *first_;		// insertion order
+	DbPid *last_;
+
+	// snapshots, epoch-based reclamation for a single reader
+	DbSnapshot *snapshot_;		// last published snapshot
+	unsigned epoch_;		// incremented on every publish, starts at 1
+	unsigned reader_epoch_;		// epoch seen by the reader on acquire, 0 outside acquire/release
+	DbSnapshot *retired_;		// replaced snapshots the reader might still use
 };
 
 
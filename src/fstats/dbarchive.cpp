@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "dbarchive.h"
+#include "../common/common.h"
+
+#define DATA_BITS ((int) sizeof(((ArchiveBlock *) 0)->data) * 8)
+#define SAMPLE_BITS_MAX (4 + 32 + 2 + 5 + 5 + 32)	// worst case timestamp and value
+
+static inline uint32_t float_bits(float v) {
+	uint32_t rv;
+	memcpy(&rv, &v, sizeof(rv));
+	return rv;
+}
+
+static inline float bits_float(uint32_t v) {
+	float rv;
+	memcpy(&rv, &v, sizeof(rv));
+	return rv;
+}
+
+//*************************************************************
+// bit stream, most significant bit first
+//*************************************************************
+static void put_bits(ArchiveBlock *b, uint64_t val, int cnt) {
+	while (cnt > 0) {
+		int avail = 8 - b->bits % 8;
+		int take = (cnt < avail)? cnt: avail;
+		uint8_t chunk = (val >> (cnt - take)) & ((1u << take) - 1);
+		b->data[b->bits / 8] |= chunk << (avail - take);
+		b->bits += take;
+		cnt -= take;
+	}
+}
+
+// bits past the end of the block read as zero
+static uint64_t get_bits(ArchiveDecoder *dec, int cnt) {
+	uint64_t rv = 0;
+	while (cnt > 0) {
+		int avail = 8 - dec->pos % 8;
+		int take = (cnt < avail)? cnt: avail;
+		uint8_t byte = (dec->pos < DATA_BITS)? dec->block->data[dec->pos / 8]: 0;
+		rv = (rv << take) | ((byte >> (avail - take)) & ((1u << take) - 1));
+		dec->pos += take;
+		cnt -= take;
+	}
+	return rv;
+}
+
+static inline int64_t sign_extend(uint64_t val, int cnt) {
+	uint64_t sign = 1ULL << (cnt - 1);
+	return (int64_t) ((val ^ sign) - sign);
+}
+
+static inline bool fits(int64_t val, int cnt) {
+	return val >= -(1LL << (cnt - 1)) && val < (1LL << (cnt - 1));
+}
+
+//*************************************************************
+// encoder
+//*************************************************************
+static void block_reset(ArchiveBlock *b, ArchiveState *s, int col) {
+	memset(b, 0, sizeof(ArchiveBlock));
+	b->col = col;
+	memset(s, 0, sizeof(ArchiveState));
+	s->leading = -1;
+}
+
+// returns false if the block is full
+static bool block_append(ArchiveBlock *b, ArchiveState *s, int64_t t, uint32_t val) {
+	if (b->bits + SAMPLE_BITS_MAX > DATA_BITS || b->cnt == 0xffff)
+		return false;
+
+	if (b->cnt == 0) {
+		// the first time is in the header, the first value is stored in full
+		b->first = t;
+		put_bits(b, val, 32);
+	}
+	else {
+		int64_t delta = t - s->t;
+		int64_t dod = delta - s->delta;
+		if (dod == 0)
+			put_bits(b, 0, 1);
+		else if (fits(dod, 7)) {
+			put_bits(b, 2, 2);
+			put_bits(b, dod & 0x7f, 7);
+		}
+		else if (fits(dod, 9)) {
+			put_bits(b, 6, 3);
+			put_bits(b, dod & 0x1ff, 9);
+		}
+		else if (fits(dod, 12)) {
+			put_bits(b, 14, 4);
+			put_bits(b, dod & 0xfff, 12);
+		}
+		else {
+			put_bits(b, 15, 4);
+			put_bits(b, dod & 0xffffffff, 32);
+		}
+		s->delta = delta;
+
+		uint32_t x = val ^ s->val;
+		if (x == 0)
+			put_bits(b, 0, 1);
+		else {
+			int leading = __builtin_clz(x);
+			int trailing = __builtin_ctz(x);
+			if (s->leading != -1 && leading >= s->leading && trailing >= s->trailing) {
+				// inside the last window
+				put_bits(b, 2, 2);
+				put_bits(b, x >> s->trailing, 32 - s->leading - s->trailing);
+			}
+			else {
+				int len = 32 - leading - trailing;
+				put_bits(b, 3, 2);
+				put_bits(b, leading, 5);
+				put_bits(b, len - 1, 5);
+				put_bits(b, x >> trailing, len);
+				s->leading = leading;
+				s->trailing = trailing;
+			}
+		}
+	}
+
+	s->t = t;
+	s->val = val;
+	b->last = t;
+	b->cnt++;
+	return true;
+}
+
+//*************************************************************
+// decoder
+//*************************************************************
+void archive_decoder_init(ArchiveDecoder *dec, const ArchiveBlock *block) {
+	dec->block = block;
+	dec->pos = 0;
+	dec->index = 0;
+	memset(&dec->state, 0, sizeof(dec->state));
+	dec->state.leading = -1;
+}
+
+bool archive_decoder_next(ArchiveDecoder *dec, int64_t *t, float *val) {
+	const ArchiveBlock *b = dec->block;
+	ArchiveState *s = &dec->state;
+	if (dec->index >= b->cnt || dec->pos > b->bits)
+		return false;
+
+	if (dec->index == 0) {
+		s->t = b->first;
+		s->val = (uint32_t) get_bits(dec, 32);
+	}
+	else {
+		int64_t dod;
+		if (get_bits(dec, 1) == 0)
+			dod = 0;
+		else if (get_bits(dec, 1) == 0)
+			dod = sign_extend(get_bits(dec, 7), 7);
+		else if (get_bits(dec, 1) == 0)
+			dod = sign_extend(get_bits(dec, 9), 9);
+		else if (get_bits(dec, 1) == 0)
+			dod = sign_extend(get_bits(dec, 12), 12);
+		else
+			dod = sign_extend(get_bits(dec, 32), 32);
+		s->delta += dod;
+		s->t += s->delta;
+
+		if (get_bits(dec, 1)) {
+			if (get_bits(dec, 1) == 0)
+				s->val ^= (uint32_t) get_bits(dec, 32 - s->leading - s->trailing) << s->trailing;
+			else {
+				s->leading = (int) get_bits(dec, 5);
+				int len = (int) get_bits(dec, 5) + 1;
+				s->trailing = 32 - s->leading - len;
+				if (s->trailing < 0)
+					return false;
+				s->val ^= (uint32_t) get_bits(dec, len) << s->trailing;
+			}
+		}
+	}
+
+	dec->index++;
+	*t = s->t;
+	*val = bits_float(s->val);
+	return true;
+}
+
+//*************************************************************
+// archive
+//*************************************************************
+DbArchive::DbArchive(): blocks_(0), cnt_(0), size_(0), seq_(0) {
+	for (int i = 0; i < DbStorage::COLUMNS; i++)
+		block_reset(&open_[i], &state_[i], i);
+}
+
+// the copy shares the sealed blocks
+DbArchive::DbArchive(const DbArchive &src): blocks_(0), cnt_(src.cnt_), size_(src.cnt_), seq_(src.seq_) {
+	if (cnt_) {
+		blocks_ = (ArchiveBlock **) malloc(cnt_ * sizeof(ArchiveBlock *));
+		if (!blocks_)
+			errExit("malloc");
+		for (int i = 0; i < cnt_; i++) {
+			blocks_[i] = src.blocks_[i];
+			blocks_[i]->refcnt++;
+		}
+	}
+	memcpy(open_, src.open_, sizeof(open_));
+	memcpy(state_, src.state_, sizeof(state_));
+}
+
+DbArchive::~DbArchive() {
+	release();
+}
+
+void DbArchive::release() {
+	for (int i = 0; i < cnt_; i++) {
+		if (--blocks_[i]->refcnt == 0)
+			free(blocks_[i]);
+	}
+	free(blocks_);
+	blocks_ = 0;
+	cnt_ = 0;
+	size_ = 0;
+}
+
+void DbArchive::seal(int col) {
+	if (cnt_ == size_) {
+		size_ = (size_)? size_ * 2: 64;
+		blocks_ = (ArchiveBlock **) realloc(blocks_, size_ * sizeof(ArchiveBlock *));
+		if (!blocks_)
+			errExit("realloc");
+	}
+	ArchiveBlock *b = (ArchiveBlock *) malloc(sizeof(ArchiveBlock));
+	if (!b)
+		errExit("malloc");
+	memcpy(b, &open_[col], sizeof(ArchiveBlock));
+	b->seq = ++seq_;
+	b->refcnt = 1;
+	blocks_[cnt_++] = b;
+	block_reset(&open_[col], &state_[col], col);
+}
+
+// drop the sealed blocks older than cutoff
+void DbArchive::trim(int64_t cutoff) {
+	int j = 0;
+	for (int i = 0; i < cnt_; i++) {
+		if (blocks_[i]->last < cutoff) {
+			if (--blocks_[i]->refcnt == 0)
+				free(blocks_[i]);
+		}
+		else
+			blocks_[j++] = blocks_[i];
+	}
+	cnt_ = j;
+}
+
+void DbArchive::append(int64_t t, const DbStorage &row) {
+	for (int i = 0; i < DbStorage::COLUMNS; i++) {
+		// drop the low mantissa bits, the XOR of close values ends in a run of zeros
+		uint32_t val = float_bits(row.*DbStorage::columnField(i));
+		val &= ~((1u << (23 - ARCHIVE_MANTISSA)) - 1);
+
+		// keep the time increasing
+		if (open_[i].cnt && t <= state_[i].t)
+			t = state_[i].t + 1;
+		if (!block_append(&open_[i], &state_[i], t, val)) {
+			seal(i);
+			block_append(&open_[i], &state_[i], t, val);
+		}
+	}
+
+	// the oldest block of a column goes when its last value expires
+	if (cnt_ && blocks_[0]->last < t - ARCHIVE_RETENTION)
+		trim(t - ARCHIVE_RETENTION);
+}
+
+int DbArchive::load(const ArchiveBlock *sealed, int cnt, const ArchiveBlock *open, int64_t now) {
+	release();
+	seq_ = 0;
+	int dropped = 0;
+	for (int i = 0; i < cnt; i++) {
+		const ArchiveBlock *src = &sealed[i];
+		if (src->col >= DbStorage::COLUMNS || src->bits > DATA_BITS || src->last < now - ARCHIVE_RETENTION) {
+			dropped++;
+			continue;
+		}
+		memcpy(&open_[src->col], src, sizeof(ArchiveBlock));
+		seal(src->col);
+		blocks_[cnt_ - 1]->seq = src->seq;
+		if (src->seq > seq_)
+			seq_ = src->seq;
+	}
+
+	// continue the open blocks, the encoder state is the last value decoded
+	for (int i = 0; i < DbStorage::COLUMNS; i++) {
+		block_reset(&open_[i], &state_[i], i);
+		if (!open || open[i].col != i || open[i].bits > DATA_BITS || open[i].cnt == 0 ||
+		    open[i].last < now - ARCHIVE_RETENTION)
+			continue;
+		memcpy(&open_[i], &open[i], sizeof(ArchiveBlock));
+		open_[i].seq = 0;
+		open_[i].refcnt = 0;
+		ArchiveDecoder dec;
+		archive_decoder_init(&dec, &open_[i]);
+		int64_t t;
+		float val;
+		while (archive_decoder_next(&dec, &t, &val));
+		state_[i] = dec.state;
+	}
+	return dropped;
+}
+
+//*************************************************************
+// reader
+//*************************************************************
+ArchiveReader::ArchiveReader(const DbArchive *archive, int col, int64_t from, int64_t to):
+	archive_(archive), col_(col), from_(from), to_(to), index_(0), active_(false) {
+}
+
+bool ArchiveReader::next(int64_t *t, float *val) {
+	while (1) {
+		if (!active_) {
+			// next block of the column in the time range
+			const ArchiveBlock *b = 0;
+			while (index_ <= archive_->blockCnt() && !b) {
+				const ArchiveBlock *candidate = (index_ < archive_->blockCnt())?
+					archive_->block(index_): archive_->openBlock(col_);
+				index_++;
+				if (candidate->col == col_ && candidate->cnt && candidate->last >= from_ && candidate->first <= to_)
+					b = candidate;
+			}
+			if (!b)
+				return false;
+			archive_decoder_init(&dec_, b);
+			active_ = true;
+		}
+
+		while (archive_decoder_next(&dec_, t, val)) {
+			if (*t > to_)
+				break;
+			if (*t >= from_)
+				return true;
+		}
+		active_ = false;
+	}
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef DBARCHIVE_H
+#define DBARCHIVE_H
+#include <stdint.h>
+#include "dbstorage.h"
+
+#define ARCHIVE_BLOCK 256			// block size, in memory and on disk
+#define ARCHIVE_RETENTION (7 * 86400)		// seconds
+#define ARCHIVE_MANTISSA 11			// float mantissa bits kept, relative error under 0.05%
+
+// Compressed values of one column (Gorilla encoding): the timestamps are stored as delta of delta,
+// the values XOR-ed with the previous value, only the bits that changed are kept.
+struct ArchiveBlock {
+	int64_t first;		// time of the first value, seconds
+	int64_t last;		// time of the last value
+	uint32_t seq;		// sealing order starting from 1, 0 while the block is still open
+	uint16_t col;		// DbStorage column
+	uint16_t cnt;		// number of values
+	uint16_t bits;		// bits used in data
+	uint16_t refcnt;	// archives sharing a sealed block; in memory only
+	uint8_t data[ARCHIVE_BLOCK - 28];
+};
+
+// encoder state, the last value in the block
+struct ArchiveState {
+	int64_t t;
+	int64_t delta;		// last timestamp delta
+	uint32_t val;		// last value bits
+	int leading;		// leading and trailing zeros in the last XOR window, leading is -1 if none
+	int trailing;
+};
+
+// block decoder
+struct ArchiveDecoder {
+	const ArchiveBlock *block;
+	int pos;		// bit position in data
+	int index;		// values decoded
+	ArchiveState state;
+};
+void archive_decoder_init(ArchiveDecoder *dec, const ArchiveBlock *block);
+bool archive_decoder_next(ArchiveDecoder *dec, int64_t *t, float *val);
+
+// Archive tier of a sandbox: the 1h entries of the last ARCHIVE_RETENTION seconds, one block chain
+// for each column. Sealed blocks never change, they are shared by the snapshot copies; the reference
+// counts are updated only in the stats thread, where snapshots are created and deleted.
+class DbArchive {
+public:
+	DbArchive();
+	DbArchive(const DbArchive &src);
+	~DbArchive();
+
+	// add a row at time t, seconds; t is increasing
+	void append(int64_t t, const DbStorage &row);
+	// replace the content with blocks loaded from disk, open has one block for each column;
+	// returns the number of expired blocks dropped
+	int load(const ArchiveBlock *sealed, int cnt, const ArchiveBlock *open, int64_t now);
+
+	// sealed blocks for all columns, in sealing order
+	int blockCnt() const {
+		return cnt_;
+	}
+	const ArchiveBlock *block(int index) const {
+		return blocks_[index];
+	}
+	// block still open for the column; the open blocks are consecutive, starting with column 0
+	const ArchiveBlock *openBlock(int col) const {
+		return &open_[col];
+	}
+	// sequence number of the last sealed block
+	uint32_t seq() const {
+		return seq_;
+	}
+	// compressed size in bytes
+	size_t size() const {
+		return (cnt_ + DbStorage::COLUMNS) * sizeof(ArchiveBlock);
+	}
+
+private:
+	void operator=(DbArchive const&);
+	void seal(int col);
+	void trim(int64_t cutoff);
+	void release();
+
+	ArchiveBlock **blocks_;
+	int cnt_;
+	int size_;
+	uint32_t seq_;
+	ArchiveBlock open_[DbStorage::COLUMNS];
+	ArchiveState state_[DbStorage::COLUMNS];
+};
+
+// Streaming decoder for the values of a column between from and to; blocks outside the range
+// are not decoded.
+class ArchiveReader {
+public:
+	ArchiveReader(const DbArchive *archive, int col, int64_t from, int64_t to);
+	bool next(int64_t *t, float *val);
+
+private:
+	const DbArchive *archive_;
+	int col_;
+	int64_t from_;
+	int64_t to_;
+	int index_;		// next block, blockCnt() for the open block
+	bool active_;		// dec_ has a block
+	ArchiveDecoder dec_;
+};
+
+#endif
@@ -0,0 +1,450 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <time.h>
+#include <dirent.h>
+#include "dbhistory.h"
+#include "db.h"
+#include "../common/utils.h"
+
+#define HISTORY_MAGIC 0x46535448	// "FSTH"
+#define HISTORY_VERSION 3
+#define HISTORY_RECORDS 64		// records in a new file; the file grows when they are all taken
+#define HISTORY_RECORDS_MAX 1024	// then the least recently used record is dropped
+#define HISTORY_KEYLEN 128
+#define HISTORY_HEADER 4096		// header size in the file, page aligned
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t records;
+	uint32_t record_size;
+	uint32_t cycles;		// ring geometry
+	uint32_t columns;
+	uint32_t tier_1h;		// tier schedule
+	uint32_t tier_12h;
+	int32_t g1h_cycle;		// Db cycle indexes at the last update
+	int32_t g12h_cycle;
+	int32_t g12h_cycle_delta;
+	int64_t saved;			// wall clock time of the last update
+} HistoryHeader;
+
+typedef struct {
+	uint64_t hash;			// hash of key, 0 for free records
+	char key[HISTORY_KEYLEN];
+	int64_t used;			// wall clock time the sandbox was last seen
+	int32_t pid;			// sandbox saved in the record, 0 if none; reset on open
+	DbSeries<DbStorage> data_1h;
+	DbSeries<DbStorage> data_12h;
+	DbBand<DbStorage> band_1h;
+	DbBand<DbStorage> band_12h;
+	uint32_t archive_seq;		// last archive block saved in the archive file
+	ArchiveBlock archive_open[DbStorage::COLUMNS];	// archive blocks not sealed yet
+} HistoryRecord;
+
+static HistoryHeader *hdr = NULL;
+static HistoryRecord *rec = NULL;
+static int rec_cnt = 0;
+static int history_fd = -1;		// open for as long as fstats runs, it holds the lock
+static char *archive_dir = NULL;	// sealed archive blocks, one file for each record
+
+// FNV-1a
+static uint64_t hash_key(const char *key) {
+	uint64_t h = 14695981039346656037ULL;
+	for (; *key; key++) {
+		h ^= (unsigned char) *key;
+		h *= 1099511628211ULL;
+	}
+	return (h)? h: 1;
+}
+
+// the value of --option= in the command line, up to the next space
+static bool cmd_option(const char *cmd, const char *option, char *buf, int len) {
+	const char *ptr = strstr(cmd, option);
+	if (!ptr)
+		return false;
+	ptr += strlen(option);
+	int i;
+	for (i = 0; i < len - 1 && ptr[i] && ptr[i] != ' '; i++)
+		buf[i] = ptr[i];
+	buf[i] = '\0';
+	return true;
+}
+
+static void sandbox_key(DbPid *dbpid, char *key) {
+	char buf[HISTORY_KEYLEN - 8];	// room for the "profile:" prefix
+	const char *cmd = dbpid->getCmd();
+	if (dbpid->getPid() == SYSTEM_PID)
+		snprintf(key, HISTORY_KEYLEN, "system");
+	else if (!cmd)
+		snprintf(key, HISTORY_KEYLEN, "pid:%d", dbpid->getPid());
+	else if (cmd_option(cmd, "--name=", buf, sizeof(buf)))
+		snprintf(key, HISTORY_KEYLEN, "name:%s", buf);
+	else if (cmd_option(cmd, "--profile=", buf, sizeof(buf)))
+		snprintf(key, HISTORY_KEYLEN, "profile:%s", buf);
+	else
+		snprintf(key, HISTORY_KEYLEN, "cmd:%s", cmd);
+}
+
+// $XDG_STATE_HOME/firetools, or the config directory
+static char *history_dir(void) {
+	const char *state = getenv("XDG_STATE_HOME");
+	if (state && *state) {
+		char *dir;
+		if (asprintf(&dir, "%s/firetools", state) == -1)
+			errExit("asprintf");
+		mkdir(dir, 0700);
+		return dir;
+	}
+	return get_config_directory();
+}
+
+static char *archive_file(uint64_t hash) {
+	char *fname;
+	if (asprintf(&fname, "%s/%016llx", archive_dir, (unsigned long long) hash) == -1)
+		errExit("asprintf");
+	return fname;
+}
+
+static void archive_remove_all(void) {
+	DIR *dir = opendir(archive_dir);
+	if (!dir)
+		return;
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] != '.')
+			unlinkat(dirfd(dir), entry->d_name, 0);
+	}
+	closedir(dir);
+}
+
+// load the sealed blocks from the archive file and the open blocks from the record
+static void archive_load(HistoryRecord *r, DbPid *dbpid) {
+	char *fname = archive_file(r->hash);
+	ArchiveBlock *blocks = NULL;
+	int cnt = 0;
+	int fd = open(fname, O_RDONLY | O_CLOEXEC);
+	if (fd != -1) {
+		struct stat s;
+		if (fstat(fd, &s) == 0 && s.st_size >= (off_t) sizeof(ArchiveBlock)) {
+			blocks = (ArchiveBlock *) malloc(s.st_size);
+			if (!blocks)
+				errExit("malloc");
+			ssize_t len = read(fd, blocks, s.st_size);
+			cnt = (len > 0)? len / sizeof(ArchiveBlock): 0;
+		}
+		close(fd);
+	}
+	free(fname);
+
+	int dropped = dbpid->archive_.load(blocks, cnt, r->archive_open, time(NULL));
+	free(blocks);
+	// rewrite the file without the expired blocks on the next update
+	r->archive_seq = (dropped)? 0: dbpid->archive_.seq();
+}
+
+// replace the archive file with the sealed blocks in memory
+static void archive_save(HistoryRecord *r, DbPid *dbpid) {
+	char *fname = archive_file(r->hash);
+	char *tmp;
+	if (asprintf(&tmp, "%s.tmp", fname) == -1)
+		errExit("asprintf");
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd != -1) {
+		bool ok = true;
+		for (int i = 0; i < dbpid->archive_.blockCnt() && ok; i++)
+			ok = write(fd, dbpid->archive_.block(i), sizeof(ArchiveBlock)) == sizeof(ArchiveBlock);
+		close(fd);
+		if (ok && rename(tmp, fname) == 0)
+			r->archive_seq = dbpid->archive_.seq();
+		else
+			unlink(tmp);
+	}
+	free(tmp);
+	free(fname);
+}
+
+// move the rings forward over the time fstats was not running, the missed entries are zero
+static void history_advance(int entries) {
+	for (int m = 0; m < entries; m++) {
+		if (++hdr->g1h_cycle >= DbPid::MAXCYCLE)
+			hdr->g1h_cycle = 0;
+		bool g12h = false;
+		if (++hdr->g12h_cycle_delta >= arg_tier_12h) {
+			hdr->g12h_cycle_delta = 0;
+			if (++hdr->g12h_cycle >= DbPid::MAXCYCLE)
+				hdr->g12h_cycle = 0;
+			g12h = true;
+		}
+
+		for (int i = 0; i < rec_cnt; i++) {
+			rec[i].data_1h.set(hdr->g1h_cycle, DbStorage());
+			rec[i].band_1h.clear(hdr->g1h_cycle);
+			if (g12h) {
+				rec[i].data_12h.set(hdr->g12h_cycle, DbStorage());
+				rec[i].band_12h.clear(hdr->g12h_cycle);
+			}
+		}
+	}
+}
+
+void history_open(void) {
+	char *dir = history_dir();
+	if (!dir)
+		return;
+	char *fname;
+	if (asprintf(&fname, "%s/fstats.history", dir) == -1)
+		errExit("asprintf");
+	if (asprintf(&archive_dir, "%s/fstats-archive", dir) == -1)
+		errExit("asprintf");
+	free(dir);
+	mkdir(archive_dir, 0700);
+
+	int fd = open(fname, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		if (arg_debug)
+			printf("cannot open %s\n", fname);
+		free(fname);
+		return;
+	}
+	// a second fstats instance runs without history
+	if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+		if (arg_debug)
+			printf("%s is used by another fstats instance\n", fname);
+		close(fd);
+		free(fname);
+		return;
+	}
+
+	// the number of records comes from the header; a file grown by history_grow() but not
+	// updated yet is cut back
+	HistoryHeader h;
+	struct stat s;
+	bool init = fstat(fd, &s) == -1 || pread(fd, &h, sizeof(h), 0) != (ssize_t) sizeof(h) ||
+		h.magic != HISTORY_MAGIC || h.record_size != sizeof(HistoryRecord) ||
+		h.records < HISTORY_RECORDS || h.records > HISTORY_RECORDS_MAX ||
+		(size_t) s.st_size < HISTORY_HEADER + h.records * sizeof(HistoryRecord);
+	rec_cnt = (init)? HISTORY_RECORDS: (int) h.records;
+	size_t size = HISTORY_HEADER + rec_cnt * sizeof(HistoryRecord);
+	if (init && ftruncate(fd, 0) == -1) {
+		close(fd);
+		free(fname);
+		return;
+	}
+	if ((init || (size_t) s.st_size != size) && ftruncate(fd, size) == -1) {
+		close(fd);
+		free(fname);
+		return;
+	}
+
+	// the lock is held for as long as the file descriptor stays open
+	void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		close(fd);
+		free(fname);
+		return;
+	}
+	hdr = (HistoryHeader *) map;
+	rec = (HistoryRecord *) ((char *) map + HISTORY_HEADER);
+	history_fd = fd;
+
+	// check the layout; start over if it doesn't match this build
+	if (init || hdr->magic != HISTORY_MAGIC || hdr->version != HISTORY_VERSION ||
+	    hdr->records != (uint32_t) rec_cnt || hdr->record_size != sizeof(HistoryRecord) ||
+	    hdr->cycles != DbPid::MAXCYCLE || hdr->columns != DbStorage::COLUMNS ||
+	    hdr->tier_1h != (uint32_t) arg_tier_1h || hdr->tier_12h != (uint32_t) arg_tier_12h) {
+		memset(map, 0, size);
+		archive_remove_all();
+		hdr->magic = HISTORY_MAGIC;
+		hdr->version = HISTORY_VERSION;
+		hdr->records = rec_cnt;
+		hdr->record_size = sizeof(HistoryRecord);
+		hdr->cycles = DbPid::MAXCYCLE;
+		hdr->columns = DbStorage::COLUMNS;
+		hdr->tier_1h = arg_tier_1h;
+		hdr->tier_12h = arg_tier_12h;
+		hdr->g1h_cycle = Db::instance().getG1HCycle();
+		hdr->g12h_cycle = Db::instance().getG12HCycle();
+		hdr->g12h_cycle_delta = Db::instance().getG12HCycleDelta();
+		hdr->saved = time(NULL);
+		if (arg_debug)
+			printf("new history file %s\n", fname);
+	}
+	else {
+		// 1h entries missed, the 12h ring covers MAXCYCLE * arg_tier_12h of them
+		int64_t entries = (time(NULL) - hdr->saved) / arg_tier_1h;
+		if (entries < 0 || entries >= DbPid::MAXCYCLE * arg_tier_12h)
+			entries = DbPid::MAXCYCLE * arg_tier_12h;
+		history_advance((int) entries);
+		hdr->saved = time(NULL);
+		for (int i = 0; i < rec_cnt; i++)
+			rec[i].pid = 0;
+		Db::instance().restoreCycles(hdr->g1h_cycle, hdr->g12h_cycle, hdr->g12h_cycle_delta, hdr->saved);
+		if (arg_debug)
+			printf("history loaded from %s, %d 1h entries missing\n", fname, (int) entries);
+	}
+	free(fname);
+}
+
+// double the number of records in the file, up to HISTORY_RECORDS_MAX; the new records are free;
+// returns false if the file cannot grow
+static bool history_grow(void) {
+	int cnt = rec_cnt * 2;
+	if (cnt > HISTORY_RECORDS_MAX)
+		cnt = HISTORY_RECORDS_MAX;
+	if (cnt == rec_cnt)
+		return false;
+
+	size_t old = HISTORY_HEADER + rec_cnt * sizeof(HistoryRecord);
+	size_t size = HISTORY_HEADER + cnt * sizeof(HistoryRecord);
+	if (ftruncate(history_fd, size) == -1)
+		return false;
+	void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, history_fd, 0);
+	if (map == MAP_FAILED) {
+		if (ftruncate(history_fd, old) == -1)
+			hdr = NULL;	// the file doesn't match the header anymore, it is reset on the next start
+		return false;
+	}
+	munmap(hdr, old);
+	hdr = (HistoryHeader *) map;
+	rec = (HistoryRecord *) ((char *) map + HISTORY_HEADER);
+	rec_cnt = cnt;
+	hdr->records = cnt;
+	if (arg_debug)
+		printf("history file grown to %d records\n", cnt);
+	return true;
+}
+
+void history_attach(DbPid *dbpid) {
+	if (!hdr)
+		return;
+
+	char key[HISTORY_KEYLEN];
+	sandbox_key(dbpid, key);
+	uint64_t hash = hash_key(key);
+
+	// look for the sandbox; remember the free or least recently used record not in use
+	HistoryRecord *found = NULL;
+	HistoryRecord *lru = NULL;
+	for (int i = 0; i < rec_cnt; i++) {
+		HistoryRecord *r = &rec[i];
+		if (r->hash == hash && strcmp(r->key, key) == 0) {
+			found = r;
+			break;
+		}
+		if (r->pid == 0 && (!lru || r->hash == 0 || (lru->hash && r->used < lru->used)))
+			lru = r;
+	}
+
+	// all the records are taken by other sandboxes
+	int old_cnt = rec_cnt;
+	if (!found && (!lru || lru->hash) && history_grow())
+		lru = &rec[old_cnt];
+
+	if (found) {
+		// another running sandbox with the same identity has the record
+		if (found->pid)
+			return;
+		DbTiers<DbStorage> *tiers = dbpid->tiers_ = dbpid->tiers_->write();
+		tiers->data_1h_ = found->data_1h;
+		tiers->data_12h_ = found->data_12h;
+		tiers->band_1h_ = found->band_1h;
+		tiers->band_12h_ = found->band_12h;
+		archive_load(found, dbpid);
+		if (arg_debug)
+			printf("history restored for sandbox %d, %s\n", dbpid->getPid(), key);
+	}
+	else if (lru) {
+		found = lru;
+		if (found->hash) {
+			if (arg_debug)
+				printf("history full, %s replaced by %s\n", found->key, key);
+			char *fname = archive_file(found->hash);
+			unlink(fname);
+			free(fname);
+		}
+		found->hash = hash;
+		snprintf(found->key, HISTORY_KEYLEN, "%s", key);
+		found->data_1h = DbSeries<DbStorage>();
+		found->data_12h = DbSeries<DbStorage>();
+		found->band_1h = DbBand<DbStorage>();
+		found->band_12h = DbBand<DbStorage>();
+		found->archive_seq = 0;
+		memset(found->archive_open, 0, sizeof(found->archive_open));
+	}
+	else
+		return;
+
+	found->pid = dbpid->getPid();
+	found->used = time(NULL);
+}
+
+void history_detach(DbPid *dbpid) {
+	if (!hdr)
+		return;
+
+	for (int i = 0; i < rec_cnt; i++) {
+		if (rec[i].pid == dbpid->getPid()) {
+			rec[i].pid = 0;
+			return;
+		}
+	}
+}
+
+void history_update(bool g12h) {
+	if (!hdr)
+		return;
+
+	int g1hcycle = Db::instance().getG1HCycle();
+	int g12hcycle = Db::instance().getG12HCycle();
+	time_t now = time(NULL);
+	for (int i = 0; i < rec_cnt; i++) {
+		HistoryRecord *r = &rec[i];
+		DbPid *dbpid = (r->pid)? Db::instance().findPid(r->pid): NULL;
+		if (dbpid) {
+			DbTiers<DbStorage> *tiers = dbpid->tiers_;
+			r->data_1h.set(g1hcycle, tiers->data_1h_.get(g1hcycle));
+			r->band_1h.copy(g1hcycle, tiers->band_1h_);
+			if (g12h) {
+				r->data_12h.set(g12hcycle, tiers->data_12h_.get(g12hcycle));
+				r->band_12h.copy(g12hcycle, tiers->band_12h_);
+			}
+			memcpy(r->archive_open, dbpid->archive_.openBlock(0), sizeof(r->archive_open));
+			if (r->archive_seq != dbpid->archive_.seq())
+				archive_save(r, dbpid);
+			r->used = now;
+		}
+		else {
+			// not running, keep the records in step with the clock
+			r->data_1h.set(g1hcycle, DbStorage());
+			r->band_1h.clear(g1hcycle);
+			if (g12h) {
+				r->data_12h.set(g12hcycle, DbStorage());
+				r->band_12h.clear(g12hcycle);
+			}
+		}
+	}
+
+	hdr->g1h_cycle = g1hcycle;
+	hdr->g12h_cycle = g12hcycle;
+	hdr->g12h_cycle_delta = Db::instance().getG12HCycleDelta();
+	hdr->saved = now;
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef DBHISTORY_H
+#define DBHISTORY_H
+#include "dbpid.h"
+
+// The 1h and 12h tiers are saved in a memory-mapped file, $XDG_STATE_HOME/firetools/fstats.history or
+// ~/.config/firetools/fstats.history, so the long range graphs survive fstats restarts. There is one
+// record for each sandbox identity: the sandbox name, the profile, or the command line. The sealed
+// blocks of the archive tier go in a separate file for each record, under fstats-archive directory.
+
+// map the history file and restore Db cycle indexes; without it fstats keeps the history in memory only
+void history_open(void);
+// load the saved tiers into a newly configured sandbox
+void history_attach(DbPid *dbpid);
+// the sandbox is going away, stop saving it
+void history_detach(DbPid *dbpid);
+// save after a 1h transfer; the 12h tier is saved only if it was updated
+void history_update(bool g12h);
+
+#endif
@@ -19,27 +19,46 @@
 */
 #include "dbpid.h"
 
-DbPid::DbPid(pid_t pid): next_(0), pid_(pid), cmd_(0), netnamespace_(false), netnone_(false), uid_(0), configured_(false) {
+DbPid::DbPid(pid_t pid): tiers_(new DbTiers<DbStorage>), accum_(new DbAccum<DbStorage>), next_(0), prev_(0), slot_(-1), pid_(pid),
+	cmd_(0), netnamespace_(false), netnone_(false), cgroup_(0), netif_cnt_(0), uid_(0), child_(-1), configured_(false) {
+}
+
+// copy used for database snapshots, the copy is not linked in any list; only the 1min ring is copied,
+// the 1h and 12h tiers and the sealed archive blocks are shared, and the sketches are left out
+DbPid::DbPid(const DbPid &src): tiers_(src.tiers_->share()), accum_(0), archive_(src.archive_), next_(0), prev_(0), slot_(-1),
+	pid_(src.pid_), cmd_(0), netnamespace_(src.netnamespace_), netnone_(src.netnone_), cgroup_(0),
+	netif_cnt_(src.netif_cnt_), uid_(src.uid_), child_(src.child_), configured_(src.configured_) {
+	data_1min_ = src.data_1min_;
+	setCmd(src.cmd_);
+	if (src.cgroup_) {
+		cgroup_ = strdup(src.cgroup_);
+		if (!cgroup_)
+			errExit("strdup");
+	}
+	for (int i = 0; i < netif_cnt_; i++)
+		netif_[i] = new DbNetIf(*src.netif_[i]);
 }
 
 DbPid::~DbPid() {
+	tiers_->release();
+	delete accum_;
 	if (cmd_)
-		delete cmd_;
-
-	if (next_)
-		delete next_;
+		delete [] cmd_;
+	free(cgroup_);
+	for (int i = 0; i < netif_cnt_; i++)
+		delete netif_[i];
 }
 
 void DbPid::setCmd(const char *cmd) {
 	if (cmd == 0) {
 		if (cmd_)
-			delete cmd_;
+			delete [] cmd_;
 		cmd_ = 0;
 	}
 	else {
 		if (cmd_) {
 			if (strcmp(cmd_, cmd)) {
-				delete cmd_;
+				delete [] cmd_;
 				cmd_ = 0;
 			}
 		}
@@ -51,37 +70,38 @@ void DbPid::setCmd(const char *cmd) {
 	}
 }
 
-void DbPid::add(DbPid *dbpid) {
-	assert(dbpid);
-	if (!next_) {
-		next_ = dbpid;
-		return;
-	}
-
-	next_->add(dbpid);
+// cgroup is allocated memory, released by DbPid
+void DbPid::setCgroup(char *cgroup) {
+	free(cgroup_);
+	cgroup_ = cgroup;
 }
 
-void DbPid::remove(DbPid *dbpid) {
-	assert(dbpid);
-	if (next_ == dbpid) {
-		next_ = dbpid->next_;
-		return;
+DbNetIf *DbPid::findNetIf(const char *name) {
+	for (int i = 0; i < netif_cnt_; i++) {
+		if (strcmp(netif_[i]->name_, name) == 0)
+			return netif_[i];
 	}
+	if (netif_cnt_ == MAXNETIF)
+		return 0;
 
-	if (next_)
-		next_->remove(dbpid);
+	DbNetIf *netif = new DbNetIf;
+	snprintf(netif->name_, sizeof(netif->name_), "%s", name);
+	netif_[netif_cnt_++] = netif;
+	return netif;
 }
 
-DbPid *DbPid::find(pid_t pid) {
-	if (pid_ == pid) {
-		return this;
-	}
+DbNetIf::DbNetIf(): tiers_(new DbTiers<DbNetStorage>), accum_(new DbAccum<DbNetStorage>) {
+	name_[0] = '\0';
+}
 
-	if (next_) {
-		return next_->find(pid);
-	}
+DbNetIf::DbNetIf(const DbNetIf &src): tiers_(src.tiers_->share()), accum_(0) {
+	memcpy(name_, src.name_, sizeof(name_));
+	data_1min_ = src.data_1min_;
+}
 
-	return 0;
+DbNetIf::~DbNetIf() {
+	tiers_->release();
+	delete accum_;
 }
 
 void DbPid::dbgprint() {
@@ -90,10 +110,7 @@ void DbPid::dbgprint() {
 	printf("***\n");
 
 	for (int i = 0; i < MAXCYCLE; i++)
-		data_1min_[i].dbgprint(i);
-
-	if (next_)
-		next_->dbgprint();
+		data_1min_.get(i).dbgprint(i);
 }
 
 
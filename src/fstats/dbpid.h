@@ -23,33 +23,90 @@
 #include <unistd.h>
 #include "fstats.h"
 #include "dbstorage.h"
+#include "dbseries.h"
+#include "dbsketch.h"
+#include "dbarchive.h"
+
+struct DbNetIf;
+
+// 1h and 12h tiers. They change once per 1h entry, the snapshot copies share them until then; the
+// reference count is updated only in the stats thread, where the snapshots are created and deleted.
+template <class T> struct DbTiers {
+	DbSeries<T> data_1h_;
+	DbSeries<T> data_12h_;
+	DbBand<T> band_1h_;
+	DbBand<T> band_12h_;
+	int refcnt_;
+
+	DbTiers(): refcnt_(1) {}
+	static void *operator new(size_t size) {
+		return series_alloc(size);
+	}
+	static void operator delete(void *ptr) {
+		free(ptr);
+	}
+	// reference for a snapshot copy
+	DbTiers *share() {
+		refcnt_++;
+		return this;
+	}
+	void release() {
+		if (--refcnt_ == 0)
+			delete this;
+	}
+	// tiers that can be changed, a shared block is copied first
+	DbTiers *write() {
+		if (refcnt_ == 1)
+			return this;
+		DbTiers *copy = new DbTiers(*this);
+		copy->refcnt_ = 1;
+		refcnt_--;
+		return copy;
+	}
+};
+
+// samples since the last 1h and 12h entries, in the stats thread only; the snapshot copies don't have them
+template <class T> struct DbAccum {
+	T sum_1h_;		// samples weighted by their interval, since the last 1h entry
+	DbSketch<T> sketch_1h_;	// samples since the last 1h entry
+	DbSketch<T> sketch_12h_;	// 1h entries since the last 12h entry
+
+	static void *operator new(size_t size) {
+		return series_alloc(size);
+	}
+	static void operator delete(void *ptr) {
+		free(ptr);
+	}
+};
 
 class DbPid {
 public:
-	static const int MAXCYCLE = 60;
-	static const int G1HCYCLE_DELTA = 60;	// transition from 1min to 1h
-	static const int G12HCYCLE_DELTA = 12;	// transition from 1h to 12h
-	DbStorage data_1min_[MAXCYCLE];
-	DbStorage data_1h_[MAXCYCLE];
-	DbStorage data_12h_[MAXCYCLE];
+	static const int MAXCYCLE = SERIES_CYCLES;
+	static const int MAXNETIF = 8;		// network interfaces tracked for each sandbox
+	DbSeries<DbStorage> data_1min_;
+	DbTiers<DbStorage> *tiers_;	// shared with the snapshot copies, use tiers_->write() before changing it
+	DbAccum<DbStorage> *accum_;	// NULL in snapshot copies
+	DbArchive archive_;	// compressed 1h entries, ARCHIVE_RETENTION seconds
 
 	DbPid(pid_t pid);
+	DbPid(const DbPid &src);
 	~DbPid();
+	static void *operator new(size_t size) {
+		return series_alloc(size);
+	}
+	static void operator delete(void *ptr) {
+		free(ptr);
+	}
 	void setCmd(const char *cmd);
 	const char *getCmd() {
 		return cmd_;
 	}
 
-	void add(DbPid *dbpid);
-	void remove(DbPid *dbpid);
-	DbPid *find(pid_t pid);
 	void dbgprint();
+	// next sandbox in insertion order
 	DbPid *getNext() {
 		return next_;
 	}
-	void resetNext() {
-		next_ = 0;
-	}
 	pid_t getPid() {
 		return pid_;
 	}
@@ -65,12 +122,31 @@ public:
 	void setNetNone(bool val) {
 		netnone_ = val;
 	}
+	const char *getCgroup() {
+		return cgroup_;
+	}
+	void setCgroup(char *cgroup);
+	int netIfCnt() {
+		return netif_cnt_;
+	}
+	DbNetIf *netIf(int index) {
+		return netif_[index];
+	}
+	// find a network interface by name, adding it if necessary; returns NULL if there is no more room
+	DbNetIf *findNetIf(const char *name);
 	uid_t getUid() {
 		return uid_;
 	}
 	void setUid(uid_t val) {
 		uid_ = val;
 	}
+	// sandboxed process, as found by pid_find_child() in the stats thread; -1 if not found
+	pid_t getChild() {
+		return child_;
+	}
+	void setChild(pid_t val) {
+		child_ = val;
+	}
 
 	bool isConfigured() {
 		return configured_;
@@ -81,13 +157,45 @@ public:
 	}
 
 private:
+	void operator=(DbPid const&);
+	friend class Db;
+
+	// links and slot maintained by Db
 	DbPid *next_;
+	DbPid *prev_;
+	int slot_;
 	pid_t pid_;
 	char *cmd_;
 	bool netnamespace_;
 	bool netnone_;
+	char *cgroup_;	// cgroup directory for sandboxes started with --cgroup, NULL otherwise
+	DbNetIf *netif_[MAXNETIF];
+	int netif_cnt_;
 	uid_t uid_;
+	pid_t child_;
 	bool configured_;
 };
 
+// network interface in the sandbox network namespace
+struct DbNetIf {
+	char name_[16];
+	DbSeries<DbNetStorage> data_1min_;
+	DbTiers<DbNetStorage> *tiers_;
+	DbAccum<DbNetStorage> *accum_;	// NULL in snapshot copies
+
+	DbNetIf();
+	// snapshot copy
+	DbNetIf(const DbNetIf &src);
+	~DbNetIf();
+	static void *operator new(size_t size) {
+		return series_alloc(size);
+	}
+	static void operator delete(void *ptr) {
+		free(ptr);
+	}
+
+private:
+	void operator=(DbNetIf const&);
+};
+
 #endif
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include <float.h>
+#include "dbseries.h"
+#include "../common/common.h"
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SERIES_X86
+
+// AVX2 is not enabled in the build flags, check the processor at run time
+static bool have_avx2(void) {
+	static const bool rv = __builtin_cpu_supports("avx2");
+	return rv;
+}
+
+static inline float hsum128(__m128 v) {
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+static inline float hmin128(__m128 v) {
+	v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_min_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+static inline float hmax128(__m128 v) {
+	v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+__attribute__((target("avx2"))) static float sum_avx2(const float *val, int cnt) {
+	__m256 acc = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= cnt; i += 8)
+		acc = _mm256_add_ps(acc, _mm256_loadu_ps(val + i));
+	float rv = hsum128(_mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1)));
+	for (; i < cnt; i++)
+		rv += val[i];
+	return rv;
+}
+
+__attribute__((target("avx2"))) static float min_avx2(const float *val, int cnt) {
+	__m256 acc = _mm256_set1_ps(FLT_MAX);
+	int i = 0;
+	for (; i + 8 <= cnt; i += 8)
+		acc = _mm256_min_ps(acc, _mm256_loadu_ps(val + i));
+	float rv = hmin128(_mm_min_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1)));
+	for (; i < cnt; i++)
+		rv = (val[i] < rv)? val[i]: rv;
+	return rv;
+}
+
+__attribute__((target("avx2"))) static float max_avx2(const float *val, int cnt) {
+	__m256 acc = _mm256_set1_ps(-FLT_MAX);
+	int i = 0;
+	for (; i + 8 <= cnt; i += 8)
+		acc = _mm256_max_ps(acc, _mm256_loadu_ps(val + i));
+	float rv = hmax128(_mm_max_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1)));
+	for (; i < cnt; i++)
+		rv = (val[i] > rv)? val[i]: rv;
+	return rv;
+}
+
+static float sum_sse2(const float *val, int cnt) {
+	__m128 acc = _mm_setzero_ps();
+	int i = 0;
+	for (; i + 4 <= cnt; i += 4)
+		acc = _mm_add_ps(acc, _mm_loadu_ps(val + i));
+	float rv = hsum128(acc);
+	for (; i < cnt; i++)
+		rv += val[i];
+	return rv;
+}
+
+static float min_sse2(const float *val, int cnt) {
+	__m128 acc = _mm_set1_ps(FLT_MAX);
+	int i = 0;
+	for (; i + 4 <= cnt; i += 4)
+		acc = _mm_min_ps(acc, _mm_loadu_ps(val + i));
+	float rv = hmin128(acc);
+	for (; i < cnt; i++)
+		rv = (val[i] < rv)? val[i]: rv;
+	return rv;
+}
+
+static float max_sse2(const float *val, int cnt) {
+	__m128 acc = _mm_set1_ps(-FLT_MAX);
+	int i = 0;
+	for (; i + 4 <= cnt; i += 4)
+		acc = _mm_max_ps(acc, _mm_loadu_ps(val + i));
+	float rv = hmax128(acc);
+	for (; i < cnt; i++)
+		rv = (val[i] > rv)? val[i]: rv;
+	return rv;
+}
+#endif
+
+float series_sum(const float *val, int cnt) {
+#ifdef SERIES_X86
+	if (have_avx2())
+		return sum_avx2(val, cnt);
+	return sum_sse2(val, cnt);
+#else
+	float rv = 0;
+	for (int i = 0; i < cnt; i++)
+		rv += val[i];
+	return rv;
+#endif
+}
+
+float series_min(const float *val, int cnt) {
+	if (cnt <= 0)
+		return 0;
+#ifdef SERIES_X86
+	if (have_avx2())
+		return min_avx2(val, cnt);
+	return min_sse2(val, cnt);
+#else
+	float rv = val[0];
+	for (int i = 1; i < cnt; i++)
+		rv = (val[i] < rv)? val[i]: rv;
+	return rv;
+#endif
+}
+
+float series_max(const float *val, int cnt) {
+	if (cnt <= 0)
+		return 0;
+#ifdef SERIES_X86
+	if (have_avx2())
+		return max_avx2(val, cnt);
+	return max_sse2(val, cnt);
+#else
+	float rv = val[0];
+	for (int i = 1; i < cnt; i++)
+		rv = (val[i] > rv)? val[i]: rv;
+	return rv;
+#endif
+}
+
+float series_window_sum(const float *ring, int cycle, int cnt) {
+	if (cnt <= cycle + 1)
+		return series_sum(ring + cycle + 1 - cnt, cnt);
+
+	// wrapped around the start of the ring
+	int tail = cnt - (cycle + 1);
+	return series_sum(ring, cycle + 1) + series_sum(ring + SERIES_CYCLES - tail, tail);
+}
+
+void *series_alloc(size_t size) {
+	void *ptr;
+	if (posix_memalign(&ptr, 64, size))
+		errExit("posix_memalign");
+	return ptr;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef DBSERIES_H
+#define DBSERIES_H
+#include <string.h>
+#include <stdlib.h>
+
+// values in a ring, the same for the 1min, 1h and 12h tiers; it is the graph width, only the time
+// covered by an entry is configurable (--tier-1h, --tier-12h)
+#define SERIES_CYCLES 60
+#define SERIES_STRIDE 64	// ring size in memory, a multiple of the cache line size
+
+// kernels over float arrays, using AVX2 or SSE2 when available; min and max return 0 for an empty array
+float series_sum(const float *val, int cnt);
+float series_min(const float *val, int cnt);
+float series_max(const float *val, int cnt);
+// sum of the cnt values ending at cycle, going back over the start of the ring
+float series_window_sum(const float *ring, int cycle, int cnt);
+// cache line aligned memory, release it with free()
+void *series_alloc(size_t size);
+
+// Time series tier in columnar layout: a ring of SERIES_CYCLES values for each column of the row
+// type T (DbStorage or DbNetStorage), every ring starting on a cache line. Aggregation runs one
+// column at a time, over contiguous memory.
+template <class T> class DbSeries {
+public:
+	DbSeries() {
+		memset(val_, 0, sizeof(val_));
+	}
+
+	const float *ring(int col) const {
+		return val_[col];
+	}
+
+	T get(int cycle) const {
+		T row;
+		for (int i = 0; i < T::COLUMNS; i++)
+			row.*T::columnField(i) = val_[i][cycle];
+		return row;
+	}
+
+	void set(int cycle, const T &row) {
+		for (int i = 0; i < T::COLUMNS; i++)
+			val_[i][cycle] = row.*T::columnField(i);
+	}
+
+	// store at cycle the average of the cnt values ending at src_cycle in src
+	void average(int cycle, const DbSeries &src, int src_cycle, int cnt) {
+		for (int i = 0; i < T::COLUMNS; i++)
+			val_[i][cycle] = series_window_sum(src.val_[i], src_cycle, cnt) / cnt;
+	}
+
+private:
+	float val_[T::COLUMNS][SERIES_STRIDE] __attribute__((aligned(64)));
+};
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include <math.h>
+#include "dbsketch.h"
+
+int sketch_bin(float v) {
+	if (!(v >= exp2f(SKETCH_LOG2_MIN)))
+		return 0;
+	int bin = 1 + (int) floorf((log2f(v) - SKETCH_LOG2_MIN) * SKETCH_SUB);
+	return (bin < SKETCH_BINS)? bin: SKETCH_BINS - 1;
+}
+
+float sketch_percentile(const float *bin, float weight, float p, float min, float max) {
+	float target = weight * p;
+	float sum = 0;
+	int i;
+	for (i = 0; i < SKETCH_BINS; i++) {
+		sum += bin[i];
+		if (sum >= target)
+			break;
+	}
+
+	if (i == 0)
+		return min;
+	if (i == SKETCH_BINS)	// rounding
+		return max;
+
+	// interpolate on the log scale inside the bin, the bin edges limited to [min, max]
+	float lo = exp2f(SKETCH_LOG2_MIN + (float) (i - 1) / SKETCH_SUB);
+	float hi = exp2f(SKETCH_LOG2_MIN + (float) i / SKETCH_SUB);
+	if (lo < min)
+		lo = min;
+	if (hi > max)
+		hi = max;
+	if (!(lo > 0 && hi > lo))
+		return (hi > 0)? hi: 0;
+	float frac = 1 - (sum - target) / bin[i];
+	return lo * powf(hi / lo, frac);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef DBSKETCH_H
+#define DBSKETCH_H
+#include <float.h>
+#include "dbseries.h"
+
+// log2 histogram, SKETCH_SUB bins for each power of 2 between 2^SKETCH_LOG2_MIN and 2^SKETCH_LOG2_MAX;
+// bin 0 holds the smaller values and zero, the last bin everything above
+#define SKETCH_SUB 4
+#define SKETCH_LOG2_MIN -6
+#define SKETCH_LOG2_MAX 30
+#define SKETCH_BINS (1 + SKETCH_SUB * (SKETCH_LOG2_MAX - SKETCH_LOG2_MIN))
+
+// histogram bin for value v
+int sketch_bin(float v);
+// value at fraction p (0 to 1) of the total weight; the result is within [min, max]
+float sketch_percentile(const float *bin, float weight, float p, float min, float max);
+
+// Spread of a roll-up tier: minimum, maximum and 95th percentile of the samples behind each entry,
+// for every graph id of T. The mean is the tier DbSeries.
+template <class T> class DbBand {
+public:
+	enum {
+		MIN = 0,
+		MAX,
+		P95,
+		KINDS
+	};
+
+	DbBand() {
+		memset(val_, 0, sizeof(val_));
+	}
+
+	const float *ring(int kind, int id) const {
+		return val_[kind][id];
+	}
+
+	void set(int kind, int id, int cycle, float val) {
+		val_[kind][id][cycle] = val;
+	}
+
+	// copy the entry at cycle from src
+	void copy(int cycle, const DbBand &src) {
+		for (int k = 0; k < KINDS; k++) {
+			for (int i = 0; i < T::MAXID; i++)
+				val_[k][i][cycle] = src.val_[k][i][cycle];
+		}
+	}
+
+	// zero the entry at cycle
+	void clear(int cycle) {
+		for (int k = 0; k < KINDS; k++) {
+			for (int i = 0; i < T::MAXID; i++)
+				val_[k][i][cycle] = 0;
+		}
+	}
+
+private:
+	float val_[KINDS][T::MAXID][SERIES_STRIDE] __attribute__((aligned(64)));
+};
+
+// Samples since the last entry of a roll-up tier, weighted by their interval: exact minimum and
+// maximum, and a fixed size histogram for the percentiles. Sketches merge by adding the histograms.
+template <class T> class DbSketch {
+public:
+	DbSketch() {
+		reset();
+	}
+
+	void reset() {
+		memset(bin_, 0, sizeof(bin_));
+		for (int i = 0; i < T::MAXID; i++) {
+			min_[i] = FLT_MAX;
+			max_[i] = 0;
+		}
+		weight_ = 0;
+	}
+
+	void add(const T &row, float weight) {
+		for (int i = 0; i < T::MAXID; i++) {
+			float v = row.get(i);
+			bin_[i][sketch_bin(v)] += weight;
+			if (v < min_[i])
+				min_[i] = v;
+			if (v > max_[i])
+				max_[i] = v;
+		}
+		weight_ += weight;
+	}
+
+	void merge(const DbSketch &src) {
+		for (int i = 0; i < T::MAXID; i++) {
+			for (int j = 0; j < SKETCH_BINS; j++)
+				bin_[i][j] += src.bin_[i][j];
+			if (src.min_[i] < min_[i])
+				min_[i] = src.min_[i];
+			if (src.max_[i] > max_[i])
+				max_[i] = src.max_[i];
+		}
+		weight_ += src.weight_;
+	}
+
+	// write the entry at cycle in band and start over
+	void store(DbBand<T> *band, int cycle) {
+		if (weight_ == 0)
+			band->clear(cycle);
+		else {
+			for (int i = 0; i < T::MAXID; i++) {
+				band->set(DbBand<T>::MIN, i, cycle, min_[i]);
+				band->set(DbBand<T>::MAX, i, cycle, max_[i]);
+				band->set(DbBand<T>::P95, i, cycle, sketch_percentile(bin_[i], weight_, 0.95, min_[i], max_[i]));
+			}
+		}
+		reset();
+	}
+
+private:
+	float bin_[T::MAXID][SKETCH_BINS];
+	float min_[T::MAXID];
+	float max_[T::MAXID];
+	float weight_;
+};
+
+#endif
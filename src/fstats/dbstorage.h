@@ -23,23 +23,32 @@
 #include <assert.h>
 
 struct DbStorage {
+	static const int MAXID = 19;	// number of values available in get()
+	static const int COLUMNS = MAXID + 1;	// fields stored in DbSeries
 	float cpu_;
 	float rss_;
 	float shared_;
 	float rx_;
 	float tx_;
+	float pss_;	// sampled from smaps_rollup in --pss mode only
+	float uss_;
+	float swap_;
+	float io_read_;		// KB/s
+	float io_write_;	// KB/s
+	float syscr_;		// read syscalls/s
+	float syscw_;		// write syscalls/s
+	float cpu_wait_;	// runqueue wait, ms/s
+	float ctxsw_;		// context switches/s
+	float nvctxsw_;		// nonvoluntary context switches/s
+	float minflt_;		// minor page faults/s
+	float majflt_;		// major page faults/s
+	float psi_cpu_;		// pressure stall, % of time; system-wide or sandbox cgroup
+	float psi_mem_;
+	float psi_io_;
 	
-	DbStorage(): cpu_(0), rss_(0), shared_(0), rx_(0), tx_(0) {}
-	
-	DbStorage& operator=(const DbStorage& val) {
-		cpu_ = val.cpu_;
-		rss_ = val.rss_;
-		shared_ = val.shared_;
-		rx_ = val.rx_;
-		tx_ = val.tx_;
-		
-		return *this;
-	}
+	DbStorage(): cpu_(0), rss_(0), shared_(0), rx_(0), tx_(0), pss_(0), uss_(0), swap_(0),
+		io_read_(0), io_write_(0), syscr_(0), syscw_(0), cpu_wait_(0), ctxsw_(0), nvctxsw_(0),
+		minflt_(0), majflt_(0), psi_cpu_(0), psi_mem_(0), psi_io_(0) {}
 	
 	DbStorage& operator+=(const DbStorage& val) {
 		cpu_ += val.cpu_;
@@ -47,26 +56,98 @@ struct DbStorage {
 		shared_ += val.shared_;
 		rx_ += val.rx_;
 		tx_ += val.tx_;
+		pss_ += val.pss_;
+		uss_ += val.uss_;
+		swap_ += val.swap_;
+		io_read_ += val.io_read_;
+		io_write_ += val.io_write_;
+		syscr_ += val.syscr_;
+		syscw_ += val.syscw_;
+		cpu_wait_ += val.cpu_wait_;
+		ctxsw_ += val.ctxsw_;
+		nvctxsw_ += val.nvctxsw_;
+		minflt_ += val.minflt_;
+		majflt_ += val.majflt_;
+		psi_cpu_ += val.psi_cpu_;
+		psi_mem_ += val.psi_mem_;
+		psi_io_ += val.psi_io_;
 		
 		return *this;
 	}
 
-	DbStorage& operator/=(int val) {
+	DbStorage& operator/=(float val) {
 		cpu_ /= val;
 		rss_ /= val;
 		shared_ /= val;
 		rx_ /= val;
 		tx_ /= val;
+		pss_ /= val;
+		uss_ /= val;
+		swap_ /= val;
+		io_read_ /= val;
+		io_write_ /= val;
+		syscr_ /= val;
+		syscw_ /= val;
+		cpu_wait_ /= val;
+		ctxsw_ /= val;
+		nvctxsw_ /= val;
+		minflt_ /= val;
+		majflt_ /= val;
+		psi_cpu_ /= val;
+		psi_mem_ /= val;
+		psi_io_ /= val;
+		
+		return *this;
+	}
+
+	DbStorage& operator*=(float val) {
+		cpu_ *= val;
+		rss_ *= val;
+		shared_ *= val;
+		rx_ *= val;
+		tx_ *= val;
+		pss_ *= val;
+		uss_ *= val;
+		swap_ *= val;
+		io_read_ *= val;
+		io_write_ *= val;
+		syscr_ *= val;
+		syscw_ *= val;
+		cpu_wait_ *= val;
+		ctxsw_ *= val;
+		nvctxsw_ *= val;
+		minflt_ *= val;
+		majflt_ *= val;
+		psi_cpu_ *= val;
+		psi_mem_ *= val;
+		psi_io_ *= val;
 		
 		return *this;
 	}
 
 	void dbgprint(int cycle) {
-		printf("%d: %.2f, %.2f, %.2f, %.2f, %.2f\n",
-			cycle, cpu_, rss_, shared_, rx_, tx_);
+		printf("%d: %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, "
+			"%.2f, %.2f, %.2f, %.2f, %.2f\n",
+			cycle, cpu_, rss_, shared_, rx_, tx_, pss_, uss_, swap_,
+			io_read_, io_write_, syscr_, syscw_, cpu_wait_, ctxsw_, nvctxsw_,
+			minflt_, majflt_, psi_cpu_, psi_mem_, psi_io_);
 	}
 	
-	float get(int id) {
+	// series column for each field; the columns match get() ids, except for
+	// id 1 which is the sum of column 1 (rss) and the last column (shared)
+	static float DbStorage::*columnField(int col) {
+		static float DbStorage::* const fields[COLUMNS] = {
+			&DbStorage::cpu_, &DbStorage::rss_, &DbStorage::rx_, &DbStorage::tx_,
+			&DbStorage::pss_, &DbStorage::uss_, &DbStorage::swap_, &DbStorage::io_read_,
+			&DbStorage::io_write_, &DbStorage::syscr_, &DbStorage::syscw_, &DbStorage::cpu_wait_,
+			&DbStorage::ctxsw_, &DbStorage::nvctxsw_, &DbStorage::minflt_, &DbStorage::majflt_,
+			&DbStorage::psi_cpu_, &DbStorage::psi_mem_, &DbStorage::psi_io_, &DbStorage::shared_
+		};
+		assert(col < COLUMNS);
+		return fields[col];
+	}
+
+	float get(int id) const {
 		switch (id) {
 			case 0:
 				return cpu_;
@@ -76,6 +157,36 @@ struct DbStorage {
 				return rx_;
 			case 3:
 				return tx_;
+			case 4:
+				return pss_;
+			case 5:
+				return uss_;
+			case 6:
+				return swap_;
+			case 7:
+				return io_read_;
+			case 8:
+				return io_write_;
+			case 9:
+				return syscr_;
+			case 10:
+				return syscw_;
+			case 11:
+				return cpu_wait_;
+			case 12:
+				return ctxsw_;
+			case 13:
+				return nvctxsw_;
+			case 14:
+				return minflt_;
+			case 15:
+				return majflt_;
+			case 16:
+				return psi_cpu_;
+			case 17:
+				return psi_mem_;
+			case 18:
+				return psi_io_;
 			default:
 				assert(0);
 		}
@@ -84,4 +195,75 @@ struct DbStorage {
 	}
 }; 
 
+// network interface data
+struct DbNetStorage {
+	static const int MAXID = 5;	// number of values available in get()
+	static const int COLUMNS = MAXID;
+	float rx_;		// KB/s
+	float tx_;		// KB/s
+	float rx_packets_;	// packets/s
+	float tx_packets_;	// packets/s
+	float drops_;		// dropped packets/s, rx and tx
+
+	DbNetStorage(): rx_(0), tx_(0), rx_packets_(0), tx_packets_(0), drops_(0) {}
+
+	DbNetStorage& operator+=(const DbNetStorage& val) {
+		rx_ += val.rx_;
+		tx_ += val.tx_;
+		rx_packets_ += val.rx_packets_;
+		tx_packets_ += val.tx_packets_;
+		drops_ += val.drops_;
+
+		return *this;
+	}
+
+	DbNetStorage& operator/=(float val) {
+		rx_ /= val;
+		tx_ /= val;
+		rx_packets_ /= val;
+		tx_packets_ /= val;
+		drops_ /= val;
+
+		return *this;
+	}
+
+	DbNetStorage& operator*=(float val) {
+		rx_ *= val;
+		tx_ *= val;
+		rx_packets_ *= val;
+		tx_packets_ *= val;
+		drops_ *= val;
+
+		return *this;
+	}
+
+	static float DbNetStorage::*columnField(int col) {
+		static float DbNetStorage::* const fields[COLUMNS] = {
+			&DbNetStorage::rx_, &DbNetStorage::tx_, &DbNetStorage::rx_packets_,
+			&DbNetStorage::tx_packets_, &DbNetStorage::drops_
+		};
+		assert(col < COLUMNS);
+		return fields[col];
+	}
+
+	float get(int id) const {
+		switch (id) {
+			case 0:
+				return rx_;
+			case 1:
+				return tx_;
+			case 2:
+				return rx_packets_;
+			case 3:
+				return tx_packets_;
+			case 4:
+				return drops_;
+			default:
+				assert(0);
+		}
+
+		return 0;
+	}
+};
+
 #endif
@@ -24,15 +24,40 @@
 typedef enum {
 	GRAPH_1MIN = 0,
 	GRAPH_1H,
-	GRAPH_12H
+	GRAPH_12H,
+	GRAPH_ARCHIVE	// 1h entries of the last ARCHIVE_RETENTION seconds, decoded from the archive
 } GraphType;
 #define SYSTEM_PID 1
 
+// sampling period in milliseconds
+#define PERIOD_DEFAULT 1000
+#define PERIOD_MIN 250
+#define PERIOD_MAX 10000
+// sampling period while the window is hidden
+#define IDLE_PERIOD_DEFAULT 10000
+#define IDLE_PERIOD_MAX 60000	// at least one sample for each 1h entry
+// roll-up tiers: seconds in a 1h graph entry, 1h entries in a 12h graph entry
+#define TIER_1H_DEFAULT 60
+#define TIER_1H_MIN 10
+#define TIER_1H_MAX 3600
+#define TIER_12H_DEFAULT 12
+#define TIER_12H_MIN 2
+#define TIER_12H_MAX 60	// the 12h entry averages the 1h ring
+
 extern int arg_debug;
+extern int arg_pss;
+extern int arg_period;
+extern int arg_idle_period;
+extern int arg_tier_1h;
+extern int arg_tier_12h;
 extern int svg_not_found;
 
 // config.cpp
 void config_read_screen_size(int *x, int *y);
 void config_write_screen_size(int x, int y);
+int config_read_period(void);
+int config_read_idle_period(void);
+int config_read_tier_1h(void);
+int config_read_tier_12h(void);
 
 #endif
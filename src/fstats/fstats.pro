@@ -3,15 +3,24 @@ QMAKE_CFLAGS += $$(CFLAGS) -fstack-protector-all -D_FORTIFY_SOURCE=2 -fPIE -pie
 QMAKE_LFLAGS += $$(LDFLAGS) -Wl,-z,relro -Wl,-z,now
 QMAKE_LIBS += $$(LIBS) -lrt
 QT += widgets
- HEADERS       = ../common/utils.h ../common/pid.h ../common/common.h \
- 		  pid_thread.h db.h dbstorage.h dbpid.h stats_dialog.h graph.h fstats.h
+ HEADERS       = ../common/utils.h ../common/pid.h ../common/pid_events.h ../common/netns.h ../common/inspect.h ../common/common.h \
+ 		  pid_thread.h db.h dbstorage.h dbseries.h dbsketch.h dbarchive.h dbpid.h dbhistory.h stats_dialog.h sandbox_model.h job_queue.h graph.h fstats.h
  SOURCES       = main.cpp \
                   ../common/pid.cpp \
+                  ../common/pid_events.cpp \
+                  ../common/netns.cpp \
                   ../common/utils.cpp \
+                  ../common/inspect.cpp \
                  stats_dialog.cpp \
                 pid_thread.cpp \
                 db.cpp \
                 dbpid.cpp \
+                dbseries.cpp \
+                dbsketch.cpp \
+                dbarchive.cpp \
+                dbhistory.cpp \
+                 sandbox_model.cpp \
+                 job_queue.cpp \
                  graph.cpp \
                   config.cpp
 RESOURCES = fstats.qrc
@@ -17,183 +17,482 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
-#include <QtGui>
-#include <QUrl>
+#include <time.h>
+#include <QtGlobal>
+
+#if QT_VERSION >= 0x050000
+	#include <QtWidgets>
+#else
+	#include <QtGui>
+#endif
 #include "graph.h"
 #include "dbpid.h"
 #include "db.h"
 
-static QByteArray byteArray[4];
-static const char *id_label[4] = {
+static const char *id_label[DbStorage::MAXID] = {
 	"CPU (%)",
 	"Memory (KiB)",
 	"RX (KB/s)",
-	"TX (KB/s)"
+	"TX (KB/s)",
+	"PSS (KiB)",
+	"USS (KiB)",
+	"Swap (KiB)",
+	"Disk read (KB/s)",
+	"Disk write (KB/s)",
+	"Read syscalls (1/s)",
+	"Write syscalls (1/s)",
+	"CPU wait (ms/s)",
+	"Context switches (1/s)",
+	"Involuntary switches (1/s)",
+	"Minor faults (1/s)",
+	"Major faults (1/s)",
+	"CPU pressure (%)",
+	"Memory pressure (%)",
+	"I/O pressure (%)"
+};
+static const char *net_label[DbNetStorage::MAXID] = {
+	"RX (KB/s)",
+	"TX (KB/s)",
+	"RX (packets/s)",
+	"TX (packets/s)",
+	"Drops (packets/s)"
 };
 
-QString graph(int id, DbPid *dbpid, int cycle, GraphType gt) {
-	assert(id < 4);
-	assert(dbpid);
-
-	// adjust cycle for 1H
+// seconds covered by one entry in the tier selected by the graph type
+static float graph_entry(GraphType gt) {
 	if (gt == GRAPH_1H)
-		cycle =  Db::instance().getG1HCycle();
+		return arg_tier_1h;
 	else if (gt == GRAPH_12H)
-		cycle =  Db::instance().getG12HCycle();
+		return arg_tier_1h * arg_tier_12h;
+	else if (gt == GRAPH_ARCHIVE)
+		return (float) ARCHIVE_RETENTION / DbPid::MAXCYCLE;
+	return (float) arg_period / 1000;
+}
 
-	assert(cycle < DbPid::MAXCYCLE);
-	int maxcycle = DbPid::MAXCYCLE;
-	int i;
-	int j;
+// time span name: 1min, 1h, 12h...
+static QString graph_span_name(int span) {
+	if (span % 86400 == 0)
+		return QString::number(span / 86400) + "d";
+	if (span % 3600 == 0)
+		return QString::number(span / 3600) + "h";
+	if (span % 60 == 0)
+		return QString::number(span / 60) + "min";
+	return QString::number(span) + "s";
+}
+
+QString graph_links(GraphType gt) {
+	static const char *link[4] = { "1min", "1h", "12h", "archive" };
+	QString msg = "<b>Stats: </b>";
+	for (int i = GRAPH_1MIN; i <= GRAPH_ARCHIVE; i++) {
+		QString name = graph_span_name((int) (graph_entry((GraphType) i) * DbPid::MAXCYCLE));
+		if (i != GRAPH_1MIN)
+			msg += " ";
+		if (i == gt)
+			msg += name;
+		else
+			msg += QString("<a href=\"") + link[i] + "\">" + name + "</a>";
+	}
+	return msg;
+}
 
-	// set pixmap
 #define TOPMARGIN 20
 #define RIGHTMARGIN 60
-	QPixmap *pixmap = new QPixmap((maxcycle - 1) * 4 + RIGHTMARGIN, TOPMARGIN + 100 + 30);
-	QPainter *paint = new QPainter(pixmap);
-	paint->fillRect(0, 0, (maxcycle - 1) * 4 + 100, TOPMARGIN + 100 + 30, Qt::white);
-	paint->setPen(Qt::black);
-	paint->drawRect(0, TOPMARGIN, (maxcycle - 1) * 4, 100);
-	paint->setPen(QColor(80, 80, 80, 128));
-	paint->drawLine(0, TOPMARGIN + 25, (maxcycle - 1) * 4, TOPMARGIN + 25);
-	paint->drawLine(0, TOPMARGIN + 50, (maxcycle - 1) * 4, TOPMARGIN + 50);
-	paint->drawLine(0, TOPMARGIN + 75, (maxcycle - 1) * 4, TOPMARGIN + 75);
-	paint->drawLine((maxcycle - 1) * 1, TOPMARGIN, (maxcycle - 1) * 1, TOPMARGIN + 100);
-	paint->drawLine((maxcycle - 1) * 2, TOPMARGIN, (maxcycle - 1) * 2, TOPMARGIN + 100);
-	paint->drawLine((maxcycle - 1) * 3, TOPMARGIN, (maxcycle - 1) * 3, TOPMARGIN + 100);
+#define PLOT_WIDTH ((DbPid::MAXCYCLE - 1) * 4 + 1)
+#define PLOT_HEIGHT 101
 
-	// extract maximum value
-	float maxval = 0;
-	for (i = 0; i < maxcycle; i++) {
-		float val;
-		if (gt == GRAPH_1MIN)
-			val  = dbpid->data_1min_[i].get(id);
-		else if (gt == GRAPH_1H)
-			val  = dbpid->data_1h_[i].get(id);
-		else if (gt == GRAPH_12H)
-			val  = dbpid->data_12h_[i].get(id);
-		else
-			assert(0);
+// series drawn in a graph
+#define SERIES_MEAN 0
+#define SERIES_MIN 1
+#define SERIES_MAX 2
+#define SERIES_P95 3
+#define SERIES_CNT 4
 
-		if (val > maxval)
-			maxval = val;
-	}
+// Graph kept from one cycle to the next. The plot holds only the data, over a transparent
+// background; when the values move by k entries the plot is scrolled left and only the last
+// k segments are drawn. The frame, the grid and the labels change only with the scale.
+struct GraphCache {
+	QImage plot;
+	QImage background;
+	float vals[SERIES_CNT][DbPid::MAXCYCLE];	// values drawn, oldest first
+	time_t time[DbPid::MAXCYCLE];	// entry times, 0 for entries never written
+	bool band;
+	bool p95;
+	float maxval;
+	GraphType gt;
+	QString label;
+};
 
-	// adjust maxval
+// round the maximum value up, the scale changes in steps
+static float graph_scale(float maxval) {
+	static const float step[] = {
+		2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000,
+		100000, 200000, 500000, 1000000, 2000000
+	};
 	maxval = qCeil(maxval);
-	if (maxval < 2)
-		maxval = 2;
-	else if (maxval < 5)
-		maxval = 5;
-	else if (maxval < 10)
-		maxval = 10;
-	else if (maxval < 20)
-		maxval = 20;
-	else if (maxval < 50)
-		maxval = 50;
-	else if (maxval < 100)
-		maxval = 100;
-	else if (maxval < 200)
-		maxval = 200;
-	else if (maxval < 500)
-		maxval = 500;
-	else if (maxval < 1000)
-		maxval = 1000;
-	else if (maxval < 2000)
-		maxval = 2000;
-	else if (maxval < 5000)
-		maxval = 5000;
-	else if (maxval < 10000)
-		maxval = 10000;
-	else if (maxval < 20000)
-		maxval = 20000;
-	else if (maxval < 50000)
-		maxval = 50000;
-	else if (maxval < 100000)
-		maxval = 100000;
-	else if (maxval < 200000)
-		maxval = 200000;
-	else if (maxval < 500000)
-		maxval = 500000;
-	else if (maxval < 1000000)
-		maxval = 1000000;
-	else if (maxval < 2000000)
-		maxval = 2000000;
-
-	paint->setPen(Qt::red);
-	for (i = 0, j = cycle + 1; i < maxcycle - 1; i++) {
-		float y1;
-		if (gt == GRAPH_1MIN)
-			y1 = dbpid->data_1min_[j].get(id);
-		else if (gt == GRAPH_1H)
-			y1 = dbpid->data_1h_[j].get(id);
-		else if (gt == GRAPH_12H)
-			y1 = dbpid->data_12h_[j].get(id);
-		else
-			assert(0);
-
-		y1 = (y1 / maxval) * 100;
-		y1 = 100 - y1 + TOPMARGIN;
-		j++;
-		if (j >= maxcycle)
-			j = 0;
+	for (unsigned i = 0; i < sizeof(step) / sizeof(step[0]); i++) {
+		if (maxval < step[i])
+			return step[i];
+	}
+	return maxval;
+}
 
-		float y2;
-		if (gt == GRAPH_1MIN)
-			y2 = dbpid->data_1min_[j].get(id);
-		else if (gt == GRAPH_1H)
-			y2 = dbpid->data_1h_[j].get(id);
-		else if (gt == GRAPH_12H)
-			y2 = dbpid->data_12h_[j].get(id);
-		else
-			assert(0);
+static inline int plot_y(float val, float maxval) {
+	return (int) (100 - (val / maxval) * 100);
+}
 
-		y2 = (y2 / maxval) * 100;
-		y2 = 100 - y2 + TOPMARGIN;
-		paint->drawLine(i * 4, (int) y1, (i + 1) * 4, (int) y2);
+// draw segments from to to - 1; segment s joins entries s and s + 1, between x = 4s and x = 4s + 4;
+// clip_to limits the drawing to the columns left of it
+static void graph_segments(GraphCache *g, int from, int to, int clip_to = PLOT_WIDTH) {
+	QPainter paint(&g->plot);
+	paint.setClipRect(0, 0, clip_to, PLOT_HEIGHT);
+	float (*v)[DbPid::MAXCYCLE] = g->vals;
+	for (int s = from; s < to; s++) {
+		int x1 = s * 4;
+		int x2 = x1 + 4;
+		// min-max band, opaque so the segments can be drawn one at a time
+		if (g->band) {
+			QPolygon band;
+			band << QPoint(x1, plot_y(v[SERIES_MAX][s], g->maxval)) << QPoint(x2, plot_y(v[SERIES_MAX][s + 1], g->maxval))
+				<< QPoint(x2, plot_y(v[SERIES_MIN][s + 1], g->maxval)) << QPoint(x1, plot_y(v[SERIES_MIN][s], g->maxval));
+			paint.setPen(QColor(255, 208, 208));
+			paint.setBrush(QColor(255, 208, 208));
+			paint.drawPolygon(band);
+			paint.setBrush(Qt::NoBrush);
+		}
+		if (g->p95) {
+			paint.setPen(QPen(QColor(255, 0, 0, 128), 1, Qt::DotLine));
+			paint.drawLine(x1, plot_y(v[SERIES_P95][s], g->maxval), x2, plot_y(v[SERIES_P95][s + 1], g->maxval));
+		}
+		paint.setPen(Qt::red);
+		paint.drawLine(x1, plot_y(v[SERIES_MEAN][s], g->maxval), x2, plot_y(v[SERIES_MEAN][s + 1], g->maxval));
 	}
+}
+
+// frame, grid and labels
+static void graph_background(GraphCache *g) {
+	int maxcycle = DbPid::MAXCYCLE;
+	float maxval = g->maxval;
+	g->background = QImage((maxcycle - 1) * 4 + RIGHTMARGIN, TOPMARGIN + 100 + 30, QImage::Format_ARGB32_Premultiplied);
+	QPainter paint(&g->background);
+	paint.fillRect(0, 0, (maxcycle - 1) * 4 + RIGHTMARGIN, TOPMARGIN + 100 + 30, Qt::white);
+	paint.setPen(Qt::black);
+	paint.drawRect(0, TOPMARGIN, (maxcycle - 1) * 4, 100);
+	paint.setPen(QColor(80, 80, 80, 128));
+	paint.drawLine(0, TOPMARGIN + 25, (maxcycle - 1) * 4, TOPMARGIN + 25);
+	paint.drawLine(0, TOPMARGIN + 50, (maxcycle - 1) * 4, TOPMARGIN + 50);
+	paint.drawLine(0, TOPMARGIN + 75, (maxcycle - 1) * 4, TOPMARGIN + 75);
+	paint.drawLine((maxcycle - 1) * 1, TOPMARGIN, (maxcycle - 1) * 1, TOPMARGIN + 100);
+	paint.drawLine((maxcycle - 1) * 2, TOPMARGIN, (maxcycle - 1) * 2, TOPMARGIN + 100);
+	paint.drawLine((maxcycle - 1) * 3, TOPMARGIN, (maxcycle - 1) * 3, TOPMARGIN + 100);
 
 	// axis
-	paint->setPen(Qt::black);
-	QString ymax = QString::number((int) maxval);
-	paint->drawText((maxcycle - 1) * 4 + 3, TOPMARGIN + 3, QString::number((int) maxval));
+	paint.setPen(Qt::black);
+	paint.drawText((maxcycle - 1) * 4 + 3, TOPMARGIN + 3, QString::number((int) maxval));
 	if (qCeil(maxval / 2) == maxval / 2)
-		paint->drawText((maxcycle - 1) * 4 + 3, TOPMARGIN + 50 + 3, QString::number((int) maxval / 2));
+		paint.drawText((maxcycle - 1) * 4 + 3, TOPMARGIN + 50 + 3, QString::number((int) maxval / 2));
 	else
-		paint->drawText((maxcycle - 1) * 4 + 3, TOPMARGIN + 50 + 3, QString::number(maxval / 2, 'f', 1));
-	paint->drawText((maxcycle - 1) * 4 + 3, TOPMARGIN + 100 + 3, QString("0"));
-	if (gt == GRAPH_12H)
-		paint->drawText(0 + 2, TOPMARGIN + 100 + 15, QString("(hours)"));
+		paint.drawText((maxcycle - 1) * 4 + 3, TOPMARGIN + 50 + 3, QString::number(maxval / 2, 'f', 1));
+	paint.drawText((maxcycle - 1) * 4 + 3, TOPMARGIN + 100 + 3, QString("0"));
+
+	// time axis, in the unit fitting the span of the ring
+	float span = graph_entry(g->gt) * maxcycle;
+	float unit = 1;
+	const char *unit_name = "(seconds)";
+	if (span >= 4 * 86400) {
+		unit = 86400;
+		unit_name = "(days)";
+	}
+	else if (span >= 6 * 3600) {
+		unit = 3600;
+		unit_name = "(hours)";
+	}
+	else if (span >= 600) {
+		unit = 60;
+		unit_name = "(minutes)";
+	}
+	paint.drawText(0 + 2, TOPMARGIN + 100 + 15, QString(unit_name));
+	paint.drawText((maxcycle - 1) * 2 - 5, TOPMARGIN + 100 + 15, QString::number(-span / unit / 2, 'g', 3));
+	paint.drawText((maxcycle - 1) * 3 - 5, TOPMARGIN + 100 + 15, QString::number(-span / unit / 4, 'g', 3));
+
+	// title
+	paint.drawText(0 + 2, TOPMARGIN - 2, g->label);
+}
+
+// entries the drawn values moved by: vals are the drawn values moved left k entries, with k new
+// entries at the end; -1 if they don't match
+static int graph_shift(GraphCache *g, float (*vals)[DbPid::MAXCYCLE]) {
+	int maxcycle = DbPid::MAXCYCLE;
+	for (int k = 0; k < maxcycle - 1; k++) {
+		bool match = true;
+		for (int i = 0; i < SERIES_CNT && match; i++)
+			match = memcmp(g->vals[i] + k, vals[i], (maxcycle - k) * sizeof(float)) == 0;
+		if (match)
+			return k;
+	}
+	return -1;
+}
+
+// scroll the plot left by k entries, then clear the columns right of the start of segment from and
+// the first segment, left with the end of the segment scrolled out
+static void graph_scroll(GraphCache *g, int k, int from) {
+	int shift = k * 4 * 4;		// bytes, 4 pixels for each entry
+	int keep = (from * 4 + 1) * 4;
+	for (int y = 0; y < PLOT_HEIGHT; y++) {
+		uchar *line = g->plot.scanLine(y);
+		memmove(line, line + shift, PLOT_WIDTH * 4 - shift);
+		memset(line + keep, 0, PLOT_WIDTH * 4 - keep);
+		memset(line, 0, 4 * 4);
+	}
+}
+
+// draw the graph for the values in vals ring, cycle is the most recent value; min, max and p95 rings
+// are the spread of the samples behind each value in the roll-up tiers, NULL in the 1min tier;
+// the archive has no p95. Returns false if the graph did not change.
+static bool graph_draw(GraphCache *g, const QString &label, const float *vals, const float *min,
+		const float *max, const float *p95, int cycle, GraphType gt) {
+	assert(cycle < DbPid::MAXCYCLE);
+	int maxcycle = DbPid::MAXCYCLE;
+
+	// values in time order
+	float v[SERIES_CNT][DbPid::MAXCYCLE];
+	memset(v, 0, sizeof(v));
+	for (int i = 0, j = cycle + 1; i < maxcycle; i++, j++) {
+		if (j >= maxcycle)
+			j = 0;
+		v[SERIES_MEAN][i] = vals[j];
+		if (min && max) {
+			v[SERIES_MIN][i] = min[j];
+			v[SERIES_MAX][i] = max[j];
+		}
+		if (p95)
+			v[SERIES_P95][i] = p95[j];
+	}
+
+	// extract maximum value
+	float maxval = series_max((max)? v[SERIES_MAX]: v[SERIES_MEAN], maxcycle);
+	if (maxval < 0)
+		maxval = 0;
+	maxval = graph_scale(maxval);
+
+	bool full = g->maxval != maxval || g->gt != gt || g->label != label ||
+		g->band != (min && max) || g->p95 != (p95 != NULL);
+	int k = (full)? -1: graph_shift(g, v);
+	if (k == 0)
+		return false;
+
+	memcpy(g->vals, v, sizeof(v));
+	g->band = min && max;
+	g->p95 = p95 != NULL;
+	g->gt = gt;
+	if (full) {
+		g->maxval = maxval;
+		g->label = label;
+		graph_background(g);
+	}
+	if (k == -1) {
+		g->plot.fill(0);
+		graph_segments(g, 0, maxcycle - 1);
+	}
+	else {
+		// the segments ending in the new entries
+		int from = maxcycle - 1 - k;
+		graph_scroll(g, k, from);
+		graph_segments(g, 0, 1, 4);
+		graph_segments(g, from, maxcycle - 1);
+	}
+	return true;
+}
+
+// current cycle in the tier selected by the graph type
+static int graph_cycle(DbSnapshot *snap, GraphType gt) {
 	if (gt == GRAPH_1H)
-		paint->drawText(0 + 2, TOPMARGIN + 100 + 15, QString("(minutes)"));
-	else
-		paint->drawText(0 + 2, TOPMARGIN + 100 + 15, QString("(seconds)"));
-	if (gt == GRAPH_1MIN) {
-		paint->drawText((maxcycle - 1) * 2 - 5, TOPMARGIN + 100 + 15, QString("-30"));
-		paint->drawText((maxcycle - 1) * 3 - 5, TOPMARGIN + 100 + 15, QString("-15"));
+		return snap->getG1HCycle();
+	else if (gt == GRAPH_12H)
+		return snap->getG12HCycle();
+	return snap->getCycle();
+}
+
+// entry times in time order
+static void graph_times(GraphCache *g, DbSnapshot *snap, GraphType gt) {
+	int cycle = graph_cycle(snap, gt);
+	for (int i = 0, j = cycle + 1; i < DbPid::MAXCYCLE; i++, j++) {
+		if (j >= DbPid::MAXCYCLE)
+			j = 0;
+		g->time[i] = snap->getTime(gt, j);
+	}
+}
+
+// mean, min and max of the archived 1h entries, MAXCYCLE buckets ending now
+static bool graph_archive(GraphCache *g, int id, DbPid *dbpid) {
+	float vals[DbPid::MAXCYCLE];
+	float min[DbPid::MAXCYCLE];
+	float max[DbPid::MAXCYCLE];
+	int cnt[DbPid::MAXCYCLE];
+	memset(vals, 0, sizeof(vals));
+	memset(min, 0, sizeof(min));
+	memset(max, 0, sizeof(max));
+	memset(cnt, 0, sizeof(cnt));
+
+	int64_t now = time(NULL);
+	int64_t from = now - ARCHIVE_RETENTION;
+	int64_t bucket = ARCHIVE_RETENTION / DbPid::MAXCYCLE;
+
+	// the columns are the graph ids, memory is rss plus shared; the columns are appended together,
+	// the readers stay in step
+	ArchiveReader reader(&dbpid->archive_, id, from, now);
+	ArchiveReader shared(&dbpid->archive_, DbStorage::COLUMNS - 1, from, now);
+	int64_t t;
+	float val;
+	while (reader.next(&t, &val)) {
+		if (id == 1) {
+			int64_t t2;
+			float val2;
+			if (shared.next(&t2, &val2))
+				val += val2;
+		}
+
+		int i = (t - from) / bucket;
+		if (i >= DbPid::MAXCYCLE)
+			i = DbPid::MAXCYCLE - 1;
+		if (cnt[i] == 0 || val < min[i])
+			min[i] = val;
+		if (cnt[i] == 0 || val > max[i])
+			max[i] = val;
+		vals[i] += val;
+		cnt[i]++;
 	}
-	else if (gt == GRAPH_1H) {
-		paint->drawText((maxcycle - 1) * 2 - 5, TOPMARGIN + 100 + 15, QString("-30"));
-		paint->drawText((maxcycle - 1) * 3 - 5, TOPMARGIN + 100 + 15, QString("-15"));
+	for (int i = 0; i < DbPid::MAXCYCLE; i++) {
+		if (cnt[i])
+			vals[i] /= cnt[i];
+		g->time[i] = (cnt[i])? from + i * bucket: 0;
+	}
+
+	return graph_draw(g, id_label[id], vals, min, max, NULL, DbPid::MAXCYCLE - 1, GRAPH_ARCHIVE);
+}
+
+GraphWidget::GraphWidget(QWidget *parent): QWidget(parent) {
+	cache_ = new GraphCache;
+	cache_->plot = QImage(PLOT_WIDTH, PLOT_HEIGHT, QImage::Format_ARGB32_Premultiplied);
+	cache_->maxval = 0;	// the first graph is drawn in full
+	setFixedSize((DbPid::MAXCYCLE - 1) * 4 + RIGHTMARGIN, TOPMARGIN + 100 + 30);
+}
+
+GraphWidget::~GraphWidget() {
+	delete cache_;
+}
+
+void GraphWidget::setGraph(int id, DbPid *dbpid, DbSnapshot *snap, GraphType gt) {
+	assert(id < DbStorage::MAXID);
+	assert(dbpid);
+	if (gt == GRAPH_ARCHIVE) {
+		if (graph_archive(cache_, id, dbpid))
+			update();
+		return;
+	}
+
+	DbSeries<DbStorage> *data = &dbpid->data_1min_;
+	DbBand<DbStorage> *band = NULL;
+	if (gt == GRAPH_1H) {
+		data = &dbpid->tiers_->data_1h_;
+		band = &dbpid->tiers_->band_1h_;
 	}
 	else if (gt == GRAPH_12H) {
-		paint->drawText((maxcycle - 1) * 2 - 5, TOPMARGIN + 100 + 15, QString("-6"));
-		paint->drawText((maxcycle - 1) * 3 - 5, TOPMARGIN + 100 + 15, QString("-3"));
+		data = &dbpid->tiers_->data_12h_;
+		band = &dbpid->tiers_->band_12h_;
+	}
+	const float *min = (band)? band->ring(DbBand<DbStorage>::MIN, id): NULL;
+	const float *max = (band)? band->ring(DbBand<DbStorage>::MAX, id): NULL;
+	const float *p95 = (band)? band->ring(DbBand<DbStorage>::P95, id): NULL;
+	graph_times(cache_, snap, gt);
+
+	// the series columns are the graph ids, memory is split in rss and shared
+	bool changed;
+	if (id == 1) {
+		const float *rss = data->ring(1);
+		const float *shared = data->ring(DbStorage::COLUMNS - 1);
+		float vals[DbPid::MAXCYCLE];
+		for (int i = 0; i < DbPid::MAXCYCLE; i++)
+			vals[i] = rss[i] + shared[i];
+		changed = graph_draw(cache_, id_label[id], vals, min, max, p95, graph_cycle(snap, gt), gt);
 	}
 	else
-		assert(0);
+		changed = graph_draw(cache_, id_label[id], data->ring(id), min, max, p95, graph_cycle(snap, gt), gt);
+	if (changed)
+		update();
+}
 
+void GraphWidget::setGraph(int id, DbNetIf *netif, DbSnapshot *snap, GraphType gt) {
+	assert(id < DbNetStorage::MAXID);
+	assert(netif);
+	assert(gt != GRAPH_ARCHIVE);	// the interfaces are not archived
 
-	// title
-	paint->setPen(Qt::black);
-	paint->drawText(0 + 2, TOPMARGIN - 2, QString(id_label[id]));
-
-	// generate image
-	QBuffer buffer(&byteArray[id]);
-	pixmap->save(&buffer, "PNG");
-//	QString url = QString("<img src=\":resources/fjail.png\"  />");
-	QString url = QString("<img src=\"data:image/png;base64,") + byteArray[id].toBase64() + "\"  />";
-	delete paint;
-	delete pixmap;
-	return url;
+	DbSeries<DbNetStorage> *data = &netif->data_1min_;
+	DbBand<DbNetStorage> *band = NULL;
+	if (gt == GRAPH_1H) {
+		data = &netif->tiers_->data_1h_;
+		band = &netif->tiers_->band_1h_;
+	}
+	else if (gt == GRAPH_12H) {
+		data = &netif->tiers_->data_12h_;
+		band = &netif->tiers_->band_12h_;
+	}
+	const float *min = (band)? band->ring(DbBand<DbNetStorage>::MIN, id): NULL;
+	const float *max = (band)? band->ring(DbBand<DbNetStorage>::MAX, id): NULL;
+	const float *p95 = (band)? band->ring(DbBand<DbNetStorage>::P95, id): NULL;
+	graph_times(cache_, snap, gt);
+
+	QString label = QString(netif->name_) + " " + net_label[id];
+	if (graph_draw(cache_, label, data->ring(id), min, max, p95, graph_cycle(snap, gt), gt))
+		update();
+}
+
+void GraphWidget::paintEvent(QPaintEvent *event) {
+	(void) event;
+	if (cache_->maxval == 0)	// nothing drawn yet
+		return;
+	QPainter paint(this);
+	paint.drawImage(0, 0, cache_->background);
+	paint.drawImage(0, TOPMARGIN, cache_->plot);
+}
+
+static QString graph_time(time_t t, GraphType gt) {
+	char buf[64];
+	struct tm *tm = localtime(&t);
+	if (!tm || strftime(buf, sizeof(buf), (gt == GRAPH_1MIN)? "%H:%M:%S": "%a %H:%M", tm) == 0)
+		return QString();
+	return QString(buf);
+}
+
+// the entry under the mouse pointer: value, spread and time
+bool GraphWidget::event(QEvent *event) {
+	if (event->type() != QEvent::ToolTip)
+		return QWidget::event(event);
+
+	QHelpEvent *help = static_cast<QHelpEvent *>(event);
+	GraphCache *g = cache_;
+	int i = (help->x() + 2) / 4;
+	if (g->maxval == 0 || help->y() < TOPMARGIN || help->y() >= TOPMARGIN + PLOT_HEIGHT || i >= DbPid::MAXCYCLE) {
+		QToolTip::hideText();
+		event->ignore();
+		return true;
+	}
+
+	QString msg = "<b>" + g->label + "</b><br/>";
+	if (g->time[i] == 0)
+		msg += "no data";
+	else {
+		msg += QString::number(g->vals[SERIES_MEAN][i], 'f', 2);
+		if (g->band) {
+			msg += QString(" (min ") + QString::number(g->vals[SERIES_MIN][i], 'f', 2) +
+				", max " + QString::number(g->vals[SERIES_MAX][i], 'f', 2);
+			if (g->p95)
+				msg += ", p95 " + QString::number(g->vals[SERIES_P95][i], 'f', 2);
+			msg += ")";
+		}
+		msg += "<br/>" + graph_time(g->time[i], g->gt);
+		if (g->gt == GRAPH_ARCHIVE)
+			msg += " - " + graph_time(g->time[i] + ARCHIVE_RETENTION / DbPid::MAXCYCLE, g->gt);
+	}
+	QToolTip::showText(help->globalPos(), msg, this);
+	return true;
 }
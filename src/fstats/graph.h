@@ -20,10 +20,34 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 #include <QString>
+#include <QWidget>
 #include "fstats.h"
 
 class DbPid;
-QString graph(int id, DbPid *dbpid, int cycle, GraphType gt);
+class DbSnapshot;
+struct DbNetIf;
+struct GraphCache;
 
+// "Stats: 1min 1h 12h 7d" links selecting the graph type, named after the time span of each tier
+QString graph_links(GraphType gt);
+
+// graph of one series, the tooltip shows the value and the time of the entry under the mouse
+class GraphWidget: public QWidget {
+public:
+	GraphWidget(QWidget *parent = 0);
+	~GraphWidget();
+	// sandbox graph, id as in DbStorage::get(); the values are copied out of the snapshot and the
+	// widget is repainted only if they changed
+	void setGraph(int id, DbPid *dbpid, DbSnapshot *snap, GraphType gt);
+	// network interface graph, id as in DbNetStorage::get()
+	void setGraph(int id, DbNetIf *netif, DbSnapshot *snap, GraphType gt);
+
+protected:
+	void paintEvent(QPaintEvent *event);
+	bool event(QEvent *event);
+
+private:
+	GraphCache *cache_;
+};
 
 #endif
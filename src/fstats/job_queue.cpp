@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include <QStringList>
+#include <QTimer>
+#include "job_queue.h"
+#include "fstats.h"
+
+JobQueue::JobQueue(QObject *parent): QObject(parent) {
+}
+
+JobQueue::~JobQueue() {
+	cancel();
+}
+
+void JobQueue::submit(int job, const char *cmd) {
+	Job j;
+	j.job = job;
+	j.cmd = cmd;
+	j.proc = 0;
+	j.timer = 0;
+	j.failed = false;
+	queue_.enqueue(j);
+	startNext();
+}
+
+void JobQueue::startNext() {
+	while (!queue_.isEmpty() && running_.size() < JOB_PARALLEL) {
+		Job j = queue_.dequeue();
+		if (arg_debug)
+			printf("job %d: %s\n", j.job, j.cmd.constData());
+
+		j.proc = new QProcess(this);
+		connect(j.proc, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(processFinished()));
+#if QT_VERSION >= 0x050600
+		connect(j.proc, SIGNAL(errorOccurred(QProcess::ProcessError)), this, SLOT(processError(QProcess::ProcessError)));
+#else
+		connect(j.proc, SIGNAL(error(QProcess::ProcessError)), this, SLOT(processError(QProcess::ProcessError)));
+#endif
+		j.timer = new QTimer(this);
+		j.timer->setSingleShot(true);
+		connect(j.timer, SIGNAL(timeout()), this, SLOT(processTimeout()));
+
+		running_.append(j);
+		j.proc->start("/bin/sh", QStringList() << "-c" << QString::fromLocal8Bit(j.cmd));
+		j.timer->start(JOB_TIMEOUT);
+	}
+}
+
+// release the process and the timer of a running job, the process is killed if still running
+void JobQueue::stop(int index) {
+	Job j = running_.takeAt(index);
+	j.proc->disconnect(this);
+	j.timer->disconnect(this);
+	if (j.proc->state() != QProcess::NotRunning)
+		j.proc->kill();
+	j.proc->deleteLater();
+	j.timer->deleteLater();
+}
+
+// report the result of a running job and start the next one
+void JobQueue::done(int index, const QByteArray &output) {
+	int job = running_[index].job;
+	stop(index);
+	startNext();
+	emit finished(job, output);
+}
+
+void JobQueue::processFinished() {
+	QProcess *proc = qobject_cast<QProcess *>(sender());
+	for (int i = 0; i < running_.size(); i++) {
+		if (running_[i].proc == proc) {
+			done(i, proc->readAllStandardOutput());
+			return;
+		}
+	}
+}
+
+// the other errors end with a finished signal; QProcess::start() can report FailedToStart before
+// returning, so the failure is reported from the event loop, never from inside submit()
+void JobQueue::processError(QProcess::ProcessError error) {
+	if (error != QProcess::FailedToStart)
+		return;
+	QProcess *proc = qobject_cast<QProcess *>(sender());
+	for (int i = 0; i < running_.size(); i++) {
+		if (running_[i].proc == proc) {
+			running_[i].failed = true;
+			QMetaObject::invokeMethod(this, "processFailed", Qt::QueuedConnection);
+			return;
+		}
+	}
+}
+
+void JobQueue::processFailed() {
+	for (int i = 0; i < running_.size(); i++) {
+		if (running_[i].failed) {
+			done(i, QByteArray());
+			return;
+		}
+	}
+}
+
+void JobQueue::processTimeout() {
+	QTimer *timer = qobject_cast<QTimer *>(sender());
+	for (int i = 0; i < running_.size(); i++) {
+		if (running_[i].timer == timer) {
+			if (arg_debug)
+				printf("job %d timed out: %s\n", running_[i].job, running_[i].cmd.constData());
+			done(i, QByteArray());
+			return;
+		}
+	}
+}
+
+void JobQueue::cancel() {
+	queue_.clear();
+	while (!running_.isEmpty())
+		stop(0);
+}
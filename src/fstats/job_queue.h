@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef JOB_QUEUE_H
+#define JOB_QUEUE_H
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QProcess>
+#include <QQueue>
+
+class QTimer;
+
+#define JOB_PARALLEL 4		// commands running at the same time
+#define JOB_TIMEOUT 5000	// milliseconds
+
+// Runs the firejail and firemon queries in the background, in the GUI thread event loop. The commands
+// go through /bin/sh like popen() in run_program(); a command still running after JOB_TIMEOUT is killed.
+class JobQueue: public QObject {
+Q_OBJECT
+
+public:
+	JobQueue(QObject *parent = 0);
+	~JobQueue();
+	// queue a command; its standard output comes back in finished(), empty if the command failed
+	// or timed out; job is chosen by the caller
+	void submit(int job, const char *cmd);
+	// drop the queued commands and kill the running ones, there is no finished() signal for them
+	void cancel();
+
+signals:
+	void finished(int job, QByteArray output);
+
+private slots:
+	void processFinished();
+	void processError(QProcess::ProcessError error);
+	void processFailed();
+	void processTimeout();
+
+private:
+	struct Job {
+		int job;
+		QByteArray cmd;
+		QProcess *proc;
+		QTimer *timer;
+		bool failed;	// FailedToStart, reported by processFailed()
+	};
+	void startNext();
+	void stop(int index);
+	void done(int index, const QByteArray &output);
+
+	QQueue<Job> queue_;	// waiting to start
+	QList<Job> running_;
+};
+
+#endif
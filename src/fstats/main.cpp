@@ -25,8 +25,14 @@
 #include "../common/utils.h"
 #include "../../firetools_config.h"
 #include "stats_dialog.h"
+#include "dbseries.h"
 
 int arg_debug = 0;
+int arg_pss = 0;
+int arg_period = 0;
+int arg_idle_period = 0;
+int arg_tier_1h = 0;
+int arg_tier_12h = 0;
 int svg_not_found = 0;
 
 
@@ -36,7 +42,21 @@ static void usage() {
 	printf("Options:\n");
 	printf("\t--debug - debug mode\n\n");
 	printf("\t--help - this help screen\n\n");
+	printf("\t--idle-period=milliseconds - sampling period while the window is hidden,\n");
+	printf("\t\tbetween %d and %d milliseconds; the default is %d, or the\n", PERIOD_MIN, IDLE_PERIOD_MAX, IDLE_PERIOD_DEFAULT);
+	printf("\t\tidle-period line in ~/.config/firetools/fstats.config\n\n");
+	printf("\t--period=milliseconds - sampling period, between %d and %d milliseconds;\n", PERIOD_MIN, PERIOD_MAX);
+	printf("\t\tthe default is %d, or the period line in ~/.config/firetools/fstats.config\n\n", PERIOD_DEFAULT);
+	printf("\t--pss - report sandbox memory as proportional set size (PSS);\n");
+	printf("\t\tsmaps_rollup is read every 10 seconds\n\n");
+	printf("\t--tier-1h=seconds - time covered by one entry in the 1h graphs, between %d and %d\n", TIER_1H_MIN, TIER_1H_MAX);
+	printf("\t\tseconds; the default is %d, or the tier-1h line in ~/.config/firetools/fstats.config\n\n", TIER_1H_DEFAULT);
+	printf("\t--tier-12h=entries - 1h entries rolled up in one entry of the 12h graphs,\n");
+	printf("\t\tbetween %d and %d; the default is %d, or the tier-12h line in\n", TIER_12H_MIN, TIER_12H_MAX, TIER_12H_DEFAULT);
+	printf("\t\t~/.config/firetools/fstats.config\n\n");
 	printf("\t--version - print software version and exit\n\n");
+	printf("\tThe tiers are fixed at 1min, 1h and 12h graphs of %d entries each; the tier options\n", SERIES_CYCLES);
+	printf("\tchange the time covered by an entry, not the number of entries or tiers.\n\n");
 }
 
 int main(int argc, char *argv[]) {
@@ -44,6 +64,40 @@ int main(int argc, char *argv[]) {
 	for (int i = 1; i < argc; i++) {
 		if (strcmp(argv[i], "--debug") == 0)
 			arg_debug = 1;
+		else if (strcmp(argv[i], "--pss") == 0)
+			arg_pss = 1;
+		else if (strncmp(argv[i], "--period=", 9) == 0) {
+			arg_period = atoi(argv[i] + 9);
+			if (arg_period < PERIOD_MIN || arg_period > PERIOD_MAX) {
+				fprintf(stderr, "Error: invalid sampling period, use a value between %d and %d milliseconds\n",
+					PERIOD_MIN, PERIOD_MAX);
+				return 1;
+			}
+		}
+		else if (strncmp(argv[i], "--idle-period=", 14) == 0) {
+			arg_idle_period = atoi(argv[i] + 14);
+			if (arg_idle_period < PERIOD_MIN || arg_idle_period > IDLE_PERIOD_MAX) {
+				fprintf(stderr, "Error: invalid idle sampling period, use a value between %d and %d milliseconds\n",
+					PERIOD_MIN, IDLE_PERIOD_MAX);
+				return 1;
+			}
+		}
+		else if (strncmp(argv[i], "--tier-1h=", 10) == 0) {
+			arg_tier_1h = atoi(argv[i] + 10);
+			if (arg_tier_1h < TIER_1H_MIN || arg_tier_1h > TIER_1H_MAX) {
+				fprintf(stderr, "Error: invalid 1h tier, use a value between %d and %d seconds\n",
+					TIER_1H_MIN, TIER_1H_MAX);
+				return 1;
+			}
+		}
+		else if (strncmp(argv[i], "--tier-12h=", 11) == 0) {
+			arg_tier_12h = atoi(argv[i] + 11);
+			if (arg_tier_12h < TIER_12H_MIN || arg_tier_12h > TIER_12H_MAX) {
+				fprintf(stderr, "Error: invalid 12h tier, use a value between %d and %d entries\n",
+					TIER_12H_MIN, TIER_12H_MAX);
+				return 1;
+			}
+		}
 		else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-?") == 0) {
 			usage();
 			return 0;
@@ -79,6 +133,21 @@ int main(int argc, char *argv[]) {
 	// create firetools config directory if it doesn't exist
 	create_config_directory();
 
+	// sampling periods and tiers from the config file if not set on the command line
+	if (!arg_period)
+		arg_period = config_read_period();
+	if (!arg_idle_period)
+		arg_idle_period = config_read_idle_period();
+	if (!arg_tier_1h)
+		arg_tier_1h = config_read_tier_1h();
+	if (!arg_tier_12h)
+		arg_tier_12h = config_read_tier_12h();
+	// keep at least one sample in each 1h entry
+	if (arg_idle_period > arg_tier_1h * 1000)
+		arg_idle_period = arg_tier_1h * 1000;
+	if (arg_idle_period < arg_period)
+		arg_idle_period = arg_period;
+
 	// initialize resources
 	Q_INIT_RESOURCE(fstats);
 
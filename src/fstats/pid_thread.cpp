@@ -19,27 +19,191 @@
 */
 #include <QtGui>
 #include <QElapsedTimer>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 #include "pid_thread.h"
 #include "../common/pid.h"
+#include "../common/pid_events.h"
+#include "../common/netns.h"
 #include "db.h"
+#include "dbhistory.h"
 #include "../common/utils.h"
 
-bool data_ready = false;
+// smaps_rollup is expensive, read it only once every SMAPS_PERIOD milliseconds
+#define SMAPS_PERIOD 10000
 
 
-PidThread::PidThread(): ending_(false) {
+PidThread::PidThread(): ending_(false), rescan_(true), visible_(true) {
+	wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (wake_fd_ == -1 && arg_debug)
+		printf("cannot create eventfd, the window will wait for the next idle cycle\n");
 	start();
 }
 
+// called from the GUI thread
+void PidThread::setVisible(bool visible) {
+	bool old = __atomic_exchange_n(&visible_, visible, __ATOMIC_SEQ_CST);
+	if (visible && !old && wake_fd_ != -1) {
+		uint64_t val = 1;
+		ssize_t rv = write(wake_fd_, &val, sizeof(val));
+		(void) rv;
+	}
+}
+
+// sleep msec milliseconds; with the process connector active, pids array is updated while waiting
+void PidThread::waitEvents(int msec) {
+	if (!pid_events_active()) {
+		if (msec)
+			msleep(msec);
+		return;
+	}
+
+	int rv = pid_events_wait(msec);
+	if (rv == PID_EVENTS_RESCAN)
+		rescan_ = true;
+	else if (rv == PID_EVENTS_FAILED) {
+		if (arg_debug)
+			printf("process connector closed, reading /proc every cycle\n");
+		rescan_ = true;
+	}
+}
+
+static inline void ts_add_msec(struct timespec *ts, int msec) {
+	ts->tv_sec += msec / 1000;
+	ts->tv_nsec += (long) (msec % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+	else if (ts->tv_nsec < 0) {
+		ts->tv_sec--;
+		ts->tv_nsec += 1000000000;
+	}
+}
+
+static inline bool ts_before(const struct timespec *a, const struct timespec *b) {
+	return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+// elapsed time in seconds
+static inline float ts_elapsed(const struct timespec *start, const struct timespec *end) {
+	return (float) (end->tv_sec - start->tv_sec) + (float) (end->tv_nsec - start->tv_nsec) / 1000000000;
+}
+
+// sleep until the absolute CLOCK_MONOTONIC time in deadline; process connector events are handled while waiting;
+// return true if the wait was cut short by setVisible()
+bool PidThread::waitUntil(const struct timespec *deadline) {
+	while (1) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		long long msec = (long long) (deadline->tv_sec - now.tv_sec) * 1000 +
+			(deadline->tv_nsec - now.tv_nsec) / 1000000;
+		if (msec <= 0)
+			break;
+
+		struct pollfd pfd[2];
+		pfd[0].fd = wake_fd_;	// ignored by poll if -1
+		pfd[0].events = POLLIN;
+		pfd[0].revents = 0;
+		pfd[1].fd = pid_events_fd();
+		pfd[1].events = POLLIN;
+		pfd[1].revents = 0;
+		if (poll(pfd, 2, (int) msec) == -1 && errno != EINTR) {
+			if (arg_debug)
+				perror("poll");
+			break;
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			uint64_t val;
+			ssize_t rv = read(wake_fd_, &val, sizeof(val));
+			(void) rv;
+			return true;
+		}
+		if (pfd[1].revents)
+			waitEvents(0);
+	}
+
+	// sub-millisecond leftover
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR);
+	return false;
+}
+
 // todo: implement cleanup
 PidThread::~PidThread() {
 	ending_ = true;
 }
 
+// store network interface data; interfaces no longer present get zero values
+static void store_net(DbPid *dbpid, const NetNs *ns, int cycle) {
+	for (int i = 0; i < dbpid->netIfCnt(); i++)
+		dbpid->netIf(i)->data_1min_.set(cycle, DbNetStorage());
+	if (!ns)
+		return;
+
+	for (int i = 0; i < ns->ifcnt; i++) {
+		const NetIf *netif = &ns->ifs[i];
+		if (strcmp(netif->name, "lo") == 0)
+			continue;
+		DbNetIf *dbnetif = dbpid->findNetIf(netif->name);
+		if (!dbnetif)
+			continue;
+
+		DbNetStorage st;
+		st.rx_ = netif->rx / 1000;
+		st.tx_ = netif->tx / 1000;
+		st.rx_packets_ = netif->rx_pkts;
+		st.tx_packets_ = netif->tx_pkts;
+		st.drops_ = netif->drops;
+		dbnetif->data_1min_.set(cycle, st);
+	}
+}
+
+// find the sandboxed process and store it in dbpid; the GUI thread gets it from the database snapshot,
+// and never looks in pids array; returns -1 if not found
+static pid_t find_child(DbPid *dbpid) {
+	pid_t pid = dbpid->getPid();
+	pid_t child = dbpid->getChild();
+	Process *p = (child > 0)? pid_find(child): NULL;
+	// a first-level child is looked up again, the second-level child might be started later
+	if (p && p->parent != pid)
+		return child;
+
+	pid_t found = pid_find_child(pid);
+	if (found == child)
+		return child;
+	dbpid->setChild(found);
+	if (found == -1 || dbpid->netNone())
+		return found;
+
+	// detect --net=none for symlinks in /usr/local/bin; the namespace of a first-level child
+	// might not be configured yet
+	if (pid_find(found)->parent == pid)
+		return found;
+	char *fname;
+	if (asprintf(&fname, "/proc/%d/net/dev", found) == -1)
+		errExit("asprintf");
+	FILE *fp = fopen(fname, "r");
+	if (fp) {
+		char buf[4096];
+		int cnt = 0;
+		while (fgets(buf, 4096, fp))
+			cnt++;
+		fclose(fp);
+		if (cnt <= 3)
+			dbpid->setNetNone(true);
+	}
+	free(fname);
+	return found;
+}
+
 // store process data in database
-static void store(int pid, int interval, int clocktick) {
-	assert(pid < max_pids);
+// interval is the measured time between the two readings, in seconds; the sandboxed process is
+// looked up again only if probe is set, while the window is hidden a new sandbox is probed once
+static void store(int pid, Process *data, float interval, int clocktick, bool smaps, const NetNs *ns, bool probe) {
+	assert(data);
 	DbPid *dbpid = Db::instance().findPid(pid);
 
 	if (!dbpid) {
@@ -50,19 +214,64 @@ static void store(int pid, int interval, int clocktick) {
 	int cycle = Db::instance().getCycle();
 
 	// store the data in database
-	DbStorage *st = &dbpid->data_1min_[cycle];
-	st->cpu_ = (float) ((pids_data[pid].utime + pids_data[pid].stime) * 100) / (interval * clocktick);
-	st->rss_ = pids_data[pid].rss;
-	st->shared_ =  pids_data[pid].shared;
-	st->rx_ = ((float) pids_data[pid].rx) /( interval * 1000);
-	st->tx_ = ((float) pids_data[pid].tx) /( interval * 1000);
+	DbStorage row;
+	DbStorage *st = &row;
+	st->cpu_ = (float) ((data->utime + data->stime) * 100) / (interval * clocktick);
+	st->rss_ = data->rss;
+	st->shared_ =  data->shared;
+	// the namespace rates are already per second, netns measures its own interval
+	st->rx_ = ((float) data->rx) / 1000;
+	st->tx_ = ((float) data->tx) / 1000;
+	st->io_read_ = ((float) data->read_bytes) / (interval * 1000);
+	st->io_write_ = ((float) data->write_bytes) / (interval * 1000);
+	st->syscr_ = ((float) data->syscr) / interval;
+	st->syscw_ = ((float) data->syscw) / interval;
+	st->cpu_wait_ = ((float) data->run_delay) / (interval * 1000000);
+	st->ctxsw_ = ((float) (data->vcsw + data->nvcsw)) / interval;
+	st->nvctxsw_ = ((float) data->nvcsw) / interval;
+	st->minflt_ = ((float) data->minflt) / interval;
+	st->majflt_ = ((float) data->majflt) / interval;
+	// stall time in microseconds to percentage
+	st->psi_cpu_ = ((float) data->psi_cpu) / (interval * 10000);
+	st->psi_mem_ = ((float) data->psi_memory) / (interval * 10000);
+	st->psi_io_ = ((float) data->psi_io) / (interval * 10000);
+	if (smaps) {
+		st->pss_ = data->pss;
+		st->uss_ = data->uss;
+		st->swap_ = data->swap;
+	}
+	else {
+		// keep the values from the last smaps_rollup read
+		DbStorage last = dbpid->data_1min_.get((cycle)? cycle - 1: DbPid::MAXCYCLE - 1);
+		st->pss_ = last.pss_;
+		st->uss_ = last.uss_;
+		st->swap_ = last.swap_;
+	}
+	dbpid->data_1min_.set(cycle, row);
+	store_net(dbpid, ns, cycle);
+
+	// 1h tier running sums and sketches, weighted by the interval; the period is longer while the window is hidden
+	DbStorage weighted = *st;
+	weighted *= interval;
+	dbpid->accum_->sum_1h_ += weighted;
+	dbpid->accum_->sketch_1h_.add(*st, interval);
+	for (int i = 0; i < dbpid->netIfCnt(); i++) {
+		DbNetIf *netif = dbpid->netIf(i);
+		DbNetStorage netrow = netif->data_1min_.get(cycle);
+		DbNetStorage netweighted = netrow;
+		netweighted *= interval;
+		netif->accum_->sum_1h_ += netweighted;
+		netif->accum_->sketch_1h_.add(netrow, interval);
+	}
 
+	if (probe || !dbpid->isConfigured())
+		find_child(dbpid);
 	if (!dbpid->isConfigured()) {
 		if (arg_debug)
 			printf("configuring dbpid for sandbox %d\n", pid);
 
 		// user id
-		dbpid->setUid(pids_data[pid].uid);
+		dbpid->setUid(data->uid);
 
 		// check network namespace
 		char *name;
@@ -75,35 +284,41 @@ static void store(int pid, int interval, int clocktick) {
 			dbpid->setNetNamespace(false);
 		free(name);
 
-		// command line
+		// command line; the process might be gone already, it is configured again in the next cycle
 		char *cmd =  pid_proc_cmdline(pid);;
+		if (!cmd)
+			return;
 		dbpid->setCmd(cmd);
+		history_attach(dbpid);
 		if (strstr(cmd, "--net=none"))
 			dbpid->setNetNone(true);
-		else {
-			// detect --net=none for symlinks in /usr/local/bin
-			int child = pid_find_child(pid);
-			if (child != -1) {
-				char *fname;
-				if (asprintf(&fname, "/proc/%d/net/dev", child) == -1)
-					errExit("asprintf");
-				FILE *fp = fopen(fname, "r");
-				if (fp) {
-					char buf[4096];
-					int cnt = 0;
-					while (fgets(buf, 4096, fp))
-						cnt++;
-					fclose(fp);
-					if (cnt <= 3)
-						dbpid->setNetNone(true);
-				}
-			}
+
+		// pressure stall information is available for sandboxes running in their own cgroup
+		if (strstr(cmd, "--cgroup")) {
+			int child = dbpid->getChild();
+			dbpid->setCgroup(pid_get_cgroup((child != -1)? child: pid));
+			if (arg_debug)
+				printf("sandbox %d cgroup %s\n", pid, (dbpid->getCgroup())? dbpid->getCgroup(): "not found");
 		}
 		free(cmd);
 		dbpid->setConfigured();
 	}
 }
 
+// read the pressure stall times of the cgroup, or the system-wide ones if cgroup is NULL
+static void pressure(const char *cgroup, Process *data) {
+	PressureStall ps;
+	pid_get_pressure(cgroup, &ps);
+	data->psi_cpu = ps.cpu;
+	data->psi_memory = ps.memory;
+	data->psi_io = ps.io;
+}
+
+// difference between two readings of a counter summed over a sandbox; the sum goes down when processes exit
+static unsigned long long counter_delta(unsigned long long now, unsigned long long before) {
+	return (now >= before)? now - before: 0;
+}
+
 // remove closed processes from database
 static void clear() {
 	DbPid *dbpid = Db::instance().firstPid();
@@ -111,11 +326,14 @@ static void clear() {
 	while (dbpid) {
 		DbPid *next = dbpid->getNext();
 		pid_t pid = dbpid->getPid();
-		if (pids[pid].level != 1 && pid != 1) {
+		Process *p = pid_find(pid);
+		if ((!p || p->level != 1) && pid != SYSTEM_PID) {
 			// remove database entry
 			DbPid *dbentry = Db::instance().removePid(pid);
-			if (dbentry)
+			if (dbentry) {
+				history_detach(dbentry);
 				delete dbentry;
+			}
 		}
 		dbpid = next;
 	}
@@ -126,158 +344,268 @@ void PidThread::run() {
 	int pgsz = getpagesize();
 	int clocktick = sysconf(_SC_CLK_TCK);
 	bool first = true;
+	float smaps_age = SMAPS_PERIOD;	// milliseconds since the last smaps_rollup read
+	float g1h_time = 0;		// seconds sampled since the last 1h entry
+	struct timespec deadline;	// next sampling time, on a fixed grid of sampling periods
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	struct timespec start;		// time of the first reading in the cycle
+	struct timespec end;		// time of the second reading
+	Process system_data;	// system network namespace
+	memset(&system_data, 0, sizeof(system_data));
+	history_open();
+
+	// track the processes using the kernel process connector if available, otherwise read /proc every cycle;
+	// subscribe before the first /proc scan in order not to miss any events
+	if (pid_events_open() == 0) {
+		if (arg_debug)
+			printf("using the process connector\n");
+	}
 
 
 	while (1) {
 		if (ending_)
 			break;
 
-		// initialize process table - start with an empty proc table
-		pid_read(0);
+		// update process table
+		waitEvents(0);
+		if (rescan_ || !pid_events_active()) {
+			pid_read(0);
+			rescan_ = false;
+		}
 
-		// start cpu and network measurements
+		// start cpu measurements; the cpu times and page faults in pids array were read by the
+		// /proc scan or at the end of the previous cycle, they are read again in order to measure
+		// the rates over the same interval as start - end
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		pid_refresh_all();
 		unsigned utime = 0;
 		unsigned stime = 0;
-		unsigned long long rx;
-		unsigned long long tx;
-		for (int i = pids_first; i  <= pids_last; i++) {
+		for (int i = 0; i < pids_cnt; i++) {
 			if (pids[i].level == 1) {
 				// cpu
-				pid_get_cpu_sandbox(i, &utime, &stime);
-				pids_data[i].utime = utime;
-				pids_data[i].stime = stime;
-
-				// network
-				pid_get_netstats_sandbox(i, &rx, &tx);
-				pids_data[i].rx = rx;
-				pids_data[i].tx = tx;
+				pid_get_cpu_sandbox(pids[i].pid, &utime, &stime);
+				pids[i].utime = utime;
+				pids[i].stime = stime;
+
+				// storage I/O
+				pid_get_io_sandbox(pids[i].pid, &pids[i].read_bytes, &pids[i].write_bytes,
+					&pids[i].syscr, &pids[i].syscw);
+
+				// scheduler
+				pid_get_sched_sandbox(pids[i].pid, &pids[i].run_delay, &pids[i].vcsw, &pids[i].nvcsw);
+
+				// page faults, cgroup pressure
+				pid_get_faults_sandbox(pids[i].pid, &pids[i].minflt, &pids[i].majflt);
+				DbPid *dbpid = Db::instance().findPid(pids[i].pid);
+				if (dbpid && dbpid->getCgroup())
+					pressure(dbpid->getCgroup(), &pids[i]);
 			}
 		}
-		// system network
-		pid_get_netstats_sandbox(SYSTEM_PID, &rx, &tx);
-		pids_data[SYSTEM_PID].rx = rx;
-		pids_data[SYSTEM_PID].tx = tx;
+		// system pressure
+		pressure(NULL, &system_data);
 
 		if (!first) {
-			// sleep 1 second
-			msleep(500);
-			data_ready = false;
-			msleep(500);
+			// sleep until the next deadline; a scan running late moves the grid instead of
+			// firing the missed deadlines back to back
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			bool visible = __atomic_load_n(&visible_, __ATOMIC_SEQ_CST);
+			ts_add_msec(&deadline, (visible)? arg_period: arg_idle_period);
+			if (ts_before(&deadline, &now)) {
+				if (arg_debug)
+					printf("sampling deadline missed by %.02f ms\n", ts_elapsed(&deadline, &now) * 1000);
+				deadline = now;
+			}
+			if (waitUntil(&deadline)) {
+				// the window was shown, back to the full rate on a new grid
+				if (arg_debug)
+					printf("window shown, sampling every %d ms\n", arg_period);
+				deadline = start;
+				ts_add_msec(&deadline, arg_period);
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				if (ts_before(&deadline, &now))
+					deadline = now;
+				waitUntil(&deadline);
+			}
 		}
-		else
-			first = false;
 
 		// start a new database cycle
 		Db::instance().newCycle();
 
 		timetrace_start();
-		// read the cpu time again, memory
-		for (int i = pids_first; i  <= pids_last; i++) {
+		// read all the processes again, as close together as possible
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		pid_refresh_all();
+		netns_cycle();
+
+		// the first cycle has no sleep between the readings, the values are near 0 anyway
+		float interval = (first)? (float) arg_period / 1000: ts_elapsed(&start, &end);
+		first = false;
+		smaps_age += interval * 1000;
+		bool smaps_all = smaps_age >= SMAPS_PERIOD;
+		if (smaps_all)
+			smaps_age = 0;
+		// static sandbox settings are probed again only while somebody is looking
+		bool visible = __atomic_load_n(&visible_, __ATOMIC_SEQ_CST);
+
+		// cpu time, memory
+		for (int i = 0; i < pids_cnt; i++) {
 			if (pids[i].level == 1) {
+				pid_t pid = pids[i].pid;
+				Process *p = &pids[i];
+
 				// cpu time
-				pid_get_cpu_sandbox(i, &utime, &stime);
-				if (pids_data[i].utime <= utime)
-					pids_data[i].utime = utime - pids_data[i].utime;
+				pid_get_cpu_sandbox(pid, &utime, &stime);
+				if (p->utime <= utime)
+					p->utime = utime - p->utime;
 				else
-					pids_data[i].utime = 0;
+					p->utime = 0;
 
-				if (pids_data[i].stime <= stime)
-					pids_data[i].stime = stime - pids_data[i].stime;
+				if (p->stime <= stime)
+					p->stime = stime - p->stime;
 				else
-					pids_data[i].stime = 0;
+					p->stime = 0;
 
 				// memory
 				unsigned rss;
 				unsigned shared;
-				pid_get_mem_sandbox(i, &rss, &shared);
-				pids_data[i].rss = rss * pgsz / 1024;
-				pids_data[i].shared = shared * pgsz / 1024;
-
-				// network
-				DbPid *dbpid = Db::instance().findPid(i);
-				if (dbpid && dbpid->isConfigured() && dbpid->netNamespace() == true) {
-					pid_get_netstats_sandbox(i, &rx, &tx);
-					if (rx >= pids_data[i].rx)
-						pids_data[i].rx = rx - pids_data[i].rx;
-					else
-						pids_data[i].rx = 0;
-
-					if (tx > pids_data[i].tx)
-						pids_data[i].tx = tx - pids_data[i].tx;
-					else
-						pids_data[i].tx = 0;
-
+				pid_get_mem_sandbox(pid, &rss, &shared);
+				p->rss = rss * pgsz / 1024;
+				p->shared = shared * pgsz / 1024;
+
+				// cgroup pressure
+				DbPid *dbpid = Db::instance().findPid(pid);
+				if (dbpid && dbpid->getCgroup()) {
+					Process now;
+					pressure(dbpid->getCgroup(), &now);
+					p->psi_cpu = counter_delta(now.psi_cpu, p->psi_cpu);
+					p->psi_memory = counter_delta(now.psi_memory, p->psi_memory);
+					p->psi_io = counter_delta(now.psi_io, p->psi_io);
 				}
 				else {
-					pids_data[i].rx = 0;
-					pids_data[i].tx = 0;
+					p->psi_cpu = 0;
+					p->psi_memory = 0;
+					p->psi_io = 0;
 				}
 
-				store(i, 1, clocktick);
+				// network; the namespace is read once for all the sandboxes sharing it
+				const NetNs *ns = NULL;
+				if (dbpid && dbpid->isConfigured() && dbpid->netNamespace() == true)
+					ns = netns_sandbox(pid);
+				p->rx = (ns)? (unsigned long long) ns->rx: 0;
+				p->tx = (ns)? (unsigned long long) ns->tx: 0;
+
+				// storage I/O
+				unsigned long long read_bytes;
+				unsigned long long write_bytes;
+				unsigned long long syscr;
+				unsigned long long syscw;
+				pid_get_io_sandbox(pid, &read_bytes, &write_bytes, &syscr, &syscw);
+				p->read_bytes = counter_delta(read_bytes, p->read_bytes);
+				p->write_bytes = counter_delta(write_bytes, p->write_bytes);
+				p->syscr = counter_delta(syscr, p->syscr);
+				p->syscw = counter_delta(syscw, p->syscw);
+
+				// scheduler
+				unsigned long long run_delay;
+				unsigned long long vcsw;
+				unsigned long long nvcsw;
+				pid_get_sched_sandbox(pid, &run_delay, &vcsw, &nvcsw);
+				p->run_delay = counter_delta(run_delay, p->run_delay);
+				p->vcsw = counter_delta(vcsw, p->vcsw);
+				p->nvcsw = counter_delta(nvcsw, p->nvcsw);
+
+				// page faults
+				unsigned long long minflt;
+				unsigned long long majflt;
+				pid_get_faults_sandbox(pid, &minflt, &majflt);
+				p->minflt = counter_delta(minflt, p->minflt);
+				p->majflt = counter_delta(majflt, p->majflt);
+
+				// proportional memory; new sandboxes are read right away
+				bool smaps = false;
+				if (arg_pss && (smaps_all || !dbpid)) {
+					pid_get_smaps_sandbox(pid, &p->pss, &p->uss, &p->swap);
+					smaps = true;
+				}
+
+				store(pid, p, interval, clocktick, smaps, ns, visible);
 			}
 		}
 
 		// store system namespace network data
-		pid_get_netstats_sandbox(SYSTEM_PID, &rx, &tx);
-
-		if (rx >= pids_data[SYSTEM_PID].rx)
-			pids_data[SYSTEM_PID].rx = rx - pids_data[SYSTEM_PID].rx;
-		else
-			pids_data[SYSTEM_PID].rx = 0;
-
-		if (tx > pids_data[SYSTEM_PID].tx)
-			pids_data[SYSTEM_PID].tx = tx - pids_data[SYSTEM_PID].tx;
-		else
-			pids_data[SYSTEM_PID].tx = 0;
-		store(SYSTEM_PID, 1, clocktick);
+		const NetNs *ns = netns_sandbox(SYSTEM_PID);
+		system_data.rx = (ns)? (unsigned long long) ns->rx: 0;
+		system_data.tx = (ns)? (unsigned long long) ns->tx: 0;
+
+		// system pressure
+		Process now;
+		pressure(NULL, &now);
+		system_data.psi_cpu = counter_delta(now.psi_cpu, system_data.psi_cpu);
+		system_data.psi_memory = counter_delta(now.psi_memory, system_data.psi_memory);
+		system_data.psi_io = counter_delta(now.psi_io, system_data.psi_io);
+		store(SYSTEM_PID, &system_data, interval, clocktick, false, ns, visible);
 
 		float delta = timetrace_end();
 		if (arg_debug)
-			printf("stats read %.02f ms, pid from %d to %d\n", delta, pids_first, pids_last);
+			printf("stats read %.02f ms, interval %.03f s, %d sandboxed processes\n", delta, interval, pids_cnt);
 		// remove closed process entries from database
 		clear();
 
-		// 4min to 1h transfer
-		if (Db::instance().getG1HCycleDelta() == 0) {
-			// for each pid
+		// 1min to 1h transfer after arg_tier_1h seconds of samples; they may not fit in the 1min ring,
+		// use the running sums
+		g1h_time += interval;
+		if (g1h_time >= arg_tier_1h) {
+			Db::instance().newG1HCycle();
+			float sampled = g1h_time;
+			g1h_time -= arg_tier_1h;
+			// archive time, rounded to the 1h entry grid so the timestamps compress well
+			int64_t archive_time = ((int64_t) time(NULL) + arg_tier_1h / 2) / arg_tier_1h * arg_tier_1h;
+
+			// for each pid; the tiers published in the last snapshot are copied before they change
 			DbPid *dbpid = Db::instance().firstPid();
 			while (dbpid) {
-				int cycle = Db::instance().getCycle();
 				int g1hcycle = Db::instance().getG1HCycle();
-
-				DbStorage result;
-				for (int i = 0; i < DbPid::G1HCYCLE_DELTA; i++) {
-					result += dbpid->data_1min_[cycle];
-					if (--cycle < 0)
-						cycle = DbPid::MAXCYCLE - 1;
-				}
-				result /= DbPid::G1HCYCLE_DELTA;
-				dbpid->data_1h_[g1hcycle] = result;
-
-
-				if (Db::instance().getG12HCycleDelta() == 0) {
+				bool g12h = Db::instance().getG12HCycleDelta() == 0;
+				DbTiers<DbStorage> *tiers = dbpid->tiers_ = dbpid->tiers_->write();
+				DbAccum<DbStorage> *accum = dbpid->accum_;
+				accum->sum_1h_ /= sampled;
+				tiers->data_1h_.set(g1hcycle, accum->sum_1h_);
+				accum->sum_1h_ = DbStorage();
+				accum->sketch_12h_.merge(accum->sketch_1h_);
+				accum->sketch_1h_.store(&tiers->band_1h_, g1hcycle);
+				dbpid->archive_.append(archive_time, tiers->data_1h_.get(g1hcycle));
+				if (g12h) {
 					int g12hcycle = Db::instance().getG12HCycle();
-					g1hcycle = Db::instance().getG1HCycle();
+					tiers->data_12h_.average(g12hcycle, tiers->data_1h_, g1hcycle, arg_tier_12h);
+					accum->sketch_12h_.store(&tiers->band_12h_, g12hcycle);
+				}
 
-					DbStorage result2;
-					for (int i = 0; i < DbPid::G12HCYCLE_DELTA; i++) {
-						result2 += dbpid->data_1h_[g1hcycle];
-						if (--g1hcycle < 0)
-							g1hcycle = DbPid::MAXCYCLE - 1;
+				for (int i = 0; i < dbpid->netIfCnt(); i++) {
+					DbNetIf *netif = dbpid->netIf(i);
+					DbTiers<DbNetStorage> *nettiers = netif->tiers_ = netif->tiers_->write();
+					DbAccum<DbNetStorage> *netaccum = netif->accum_;
+					netaccum->sum_1h_ /= sampled;
+					nettiers->data_1h_.set(g1hcycle, netaccum->sum_1h_);
+					netaccum->sum_1h_ = DbNetStorage();
+					netaccum->sketch_12h_.merge(netaccum->sketch_1h_);
+					netaccum->sketch_1h_.store(&nettiers->band_1h_, g1hcycle);
+					if (g12h) {
+						int g12hcycle = Db::instance().getG12HCycle();
+						nettiers->data_12h_.average(g12hcycle, nettiers->data_1h_, g1hcycle, arg_tier_12h);
+						netaccum->sketch_12h_.store(&nettiers->band_12h_, g12hcycle);
 					}
-					result2 /= DbPid::G12HCYCLE_DELTA;
-					dbpid->data_12h_[g12hcycle] = result2;
 				}
 
-
 				dbpid = dbpid->getNext();
 			}
+			history_update(Db::instance().getG12HCycleDelta() == 0);
 		}
 
 
 		//Db::instance().dbgprint();
+		Db::instance().publish();
 		emit cycleReady();
-		data_ready = true;
 
 	}
 }
@@ -25,6 +25,7 @@
 #include <QThread>
 #include <QWaitCondition>
 #include <QStringList>
+#include <time.h>
 #include "fstats.h"
 
 class PidThread : public QThread
@@ -34,6 +35,8 @@ Q_OBJECT
 public:
 	PidThread();
 	~PidThread();
+	// the window was shown or hidden; sampling drops to arg_idle_period while hidden
+	void setVisible(bool visible);
 
 signals:
 	void cycleReady();
@@ -41,7 +44,14 @@ signals:
 protected:
 	void run();
 private:
-	bool ending_;		
+	void waitEvents(int msec);
+	bool waitUntil(const struct timespec *deadline);
+
+private:
+	bool ending_;
+	bool rescan_;	// pids array needs a full /proc scan
+	bool visible_;
+	int wake_fd_;	// eventfd, wakes up the thread when the window is shown
 };
 
 #endif
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include <QSet>
+#include "sandbox_model.h"
+#include "db.h"
+
+SandboxModel::SandboxModel(QObject *parent): QAbstractTableModel(parent) {
+}
+
+void SandboxModel::fill(Row *row, DbPid *dbpid, int cycle) {
+	DbStorage st = dbpid->data_1min_.get(cycle);
+	row->pid = dbpid->getPid();
+	if (dbpid->netNone())
+		row->net = NET_NONE;
+	else if (dbpid->netNamespace())
+		row->net = NET_NAMESPACE;
+	else
+		row->net = NET_SYSTEM;
+	row->val[COL_PID] = row->pid;
+	row->val[COL_CPU] = st.cpu_;
+	row->val[COL_MEM] = (arg_pss)? (int) st.pss_: (int) (st.rss_ + st.shared_);
+	row->val[COL_RX] = (row->net == NET_NAMESPACE)? st.rx_: 0;
+	row->val[COL_TX] = (row->net == NET_NAMESPACE)? st.tx_: 0;
+	row->val[COL_READ] = st.io_read_;
+	row->val[COL_WRITE] = st.io_write_;
+	row->val[COL_MAJFLT] = st.majflt_;
+	row->cmd = dbpid->getCmd();
+}
+
+void SandboxModel::update(DbSnapshot *snap) {
+	int cycle = snap->getCycle();
+	assert(cycle < DbPid::MAXCYCLE);
+
+	// sandboxes shown, in registry order
+	QVector<DbPid *> list;
+	QSet<pid_t> pids;
+	for (DbPid *dbpid = snap->firstPid(); dbpid; dbpid = dbpid->getNext()) {
+		if (dbpid->getPid() == SYSTEM_PID || !dbpid->getCmd())
+			continue;
+		list.append(dbpid);
+		pids.insert(dbpid->getPid());
+	}
+
+	// closed sandboxes, adjacent rows are removed together
+	QSet<pid_t> old;
+	for (int i = rows_.size() - 1; i >= 0; i--) {
+		if (pids.contains(rows_[i].pid)) {
+			old.insert(rows_[i].pid);
+			continue;
+		}
+		int last = i;
+		while (i > 0 && !pids.contains(rows_[i - 1].pid))
+			i--;
+		beginRemoveRows(QModelIndex(), i, last);
+		rows_.remove(i, last - i + 1);
+		endRemoveRows();
+	}
+
+	// new sandboxes, inserted where they are in the registry; the rows left keep their order
+	for (int i = 0; i < list.size(); i++) {
+		if (old.contains(list[i]->getPid()))
+			continue;
+		int last = i;
+		while (last + 1 < list.size() && !old.contains(list[last + 1]->getPid()))
+			last++;
+		beginInsertRows(QModelIndex(), i, last);
+		rows_.insert(i, last - i + 1, Row());
+		for (int j = i; j <= last; j++)
+			fill(&rows_[j], list[j], cycle);
+		endInsertRows();
+		i = last;
+	}
+
+	// a pid reused between two updates leaves the rows out of order
+	bool reset = rows_.size() != list.size();
+	for (int i = 0; i < rows_.size() && !reset; i++)
+		reset = rows_[i].pid != list[i]->getPid();
+	if (reset) {
+		beginResetModel();
+		rows_.resize(list.size());
+		for (int i = 0; i < list.size(); i++)
+			fill(&rows_[i], list[i], cycle);
+		endResetModel();
+		return;
+	}
+
+	// changed cells
+	for (int i = 0; i < rows_.size(); i++) {
+		Row row;
+		fill(&row, list[i], cycle);
+		int first = COL_CNT;
+		int last = -1;
+		for (int col = 0; col < COL_CMD; col++) {
+			bool changed = row.val[col] != rows_[i].val[col];
+			if ((col == COL_RX || col == COL_TX) && row.net != rows_[i].net)
+				changed = true;
+			if (changed) {
+				if (first == COL_CNT)
+					first = col;
+				last = col;
+			}
+		}
+		if (row.cmd != rows_[i].cmd) {
+			if (first == COL_CNT)
+				first = COL_CMD;
+			last = COL_CMD;
+		}
+		if (last == -1)
+			continue;
+		rows_[i] = row;
+		emit dataChanged(index(i, first), index(i, last));
+	}
+}
+
+int SandboxModel::rowCount(const QModelIndex &parent) const {
+	return (parent.isValid())? 0: rows_.size();
+}
+
+int SandboxModel::columnCount(const QModelIndex &parent) const {
+	return (parent.isValid())? 0: COL_CNT;
+}
+
+QVariant SandboxModel::data(const QModelIndex &index, int role) const {
+	if (!index.isValid() || index.row() >= rows_.size())
+		return QVariant();
+	const Row *row = &rows_[index.row()];
+	int col = index.column();
+
+	if (role == Qt::DisplayRole) {
+		if (col == COL_CMD)
+			return row->cmd;
+		if ((col == COL_RX || col == COL_TX) && row->net != NET_NAMESPACE) {
+			if (col == COL_TX)
+				return QString();
+			return (row->net == NET_NONE)? QString("no network"): QString("system");
+		}
+		if (col == COL_PID || col == COL_MEM)
+			return QString::number((int) row->val[col]);
+		return QString::number(row->val[col], 'f', 2);
+	}
+	else if (role == Qt::TextAlignmentRole) {
+		if (col == COL_CMD)
+			return (int) (Qt::AlignLeft | Qt::AlignVCenter);
+		return (int) (Qt::AlignRight | Qt::AlignVCenter);
+	}
+	// sort key; sandboxes without a network namespace go below the others
+	else if (role == Qt::UserRole) {
+		if (col == COL_CMD)
+			return row->cmd;
+		if ((col == COL_RX || col == COL_TX) && row->net != NET_NAMESPACE)
+			return (row->net == NET_NONE)? -2.0: -1.0;
+		return (double) row->val[col];
+	}
+	return QVariant();
+}
+
+QVariant SandboxModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	static const char *label[COL_CNT] = {
+		"PID",
+		"CPU (%)",
+		"Memory (KiB)",
+		"RX (KB/s)",
+		"TX (KB/s)",
+		"Read (KB/s)",
+		"Write (KB/s)",
+		"Major faults (1/s)",
+		"Command"
+	};
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole || section >= COL_CNT)
+		return QVariant();
+	if (section == COL_MEM && arg_pss)
+		return QString("PSS (KiB)");
+	return QString(label[section]);
+}
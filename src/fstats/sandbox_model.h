@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef SANDBOX_MODEL_H
+#define SANDBOX_MODEL_H
+#include <sys/types.h>
+#include <QAbstractTableModel>
+#include <QString>
+#include <QVector>
+#include "fstats.h"
+
+class DbSnapshot;
+class DbPid;
+
+// sandbox list on the top page, one row for each sandbox in the database, in registry order;
+// the view sorts the rows through a proxy model on Qt::UserRole
+class SandboxModel: public QAbstractTableModel {
+Q_OBJECT
+
+public:
+	enum {
+		COL_PID = 0,
+		COL_CPU,
+		COL_MEM,
+		COL_RX,
+		COL_TX,
+		COL_READ,
+		COL_WRITE,
+		COL_MAJFLT,
+		COL_CMD,
+		COL_CNT	// always the last one
+	};
+
+	SandboxModel(QObject *parent = 0);
+	// bring the rows in line with the snapshot: sandboxes started and closed are inserted and removed,
+	// dataChanged() is emitted only for the cells with new values
+	void update(DbSnapshot *snap);
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const;
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+private:
+	enum {
+		NET_SYSTEM = 0,
+		NET_NONE,
+		NET_NAMESPACE
+	};
+	struct Row {
+		pid_t pid;
+		int net;		// NET_SYSTEM, NET_NONE or NET_NAMESPACE
+		float val[COL_CMD];	// numeric columns
+		QString cmd;
+	};
+	static void fill(Row *row, DbPid *dbpid, int cycle);
+
+	QVector<Row> rows_;
+};
+
+#endif
@@ -38,18 +38,20 @@
 #include "stats_dialog.h"
 #include "db.h"
 #include "graph.h"
+#include "sandbox_model.h"
+#include "job_queue.h"
 #include "../common/common.h"
 #include "../common/utils.h"
 #include "../common/pid.h"
+#include "../common/inspect.h"
 #include "../../firetools_config.h"
 #include "../../firetools_config_extras.h"
 #include "pid_thread.h"
 #include "fstats.h"
-extern bool data_ready;
 
 static QString getName(pid_t pid);
 static QString getProfile(pid_t pid);
-static bool userNamespace(pid_t pid);
+static bool userNamespace(pid_t child);
 static int getX11Display(pid_t pid);
 
 
@@ -142,11 +144,11 @@ static char *find_fdns_shm_file_name(void) {
 
 
 StatsDialog::StatsDialog(): QDialog(), fdns_report_(0), fdns_seq_(0), fdns_fd_(0), fdns_first_run_(true),
-		mode_(MODE_TOP), pid_(0), uid_(0), lts_(false),
+		graph_cnt_(0), mode_(MODE_TOP), pid_(0), uid_(0), lts_(false),
 	pid_initialized_(false), pid_seccomp_(false), pid_caps_(QString("")), pid_noroot_(false),
 	pid_cpu_cores_(QString("")), pid_protocol_(QString("")), pid_name_(QString("")),
 	profile_(QString("")), pid_x11_(0), fdns_dump_(""),
-	have_join_(true), caps_cnt_(64), graph_type_(GRAPH_1MIN), net_none_(false), shm_file_name_(0) {
+	have_join_(true), caps_cnt_(64), graph_type_(GRAPH_1MIN), thread_(0), jobs_pending_(0), snap_(0), shm_file_name_(0) {
 
 	// clean storage area
 	cleanStorage();
@@ -163,8 +165,60 @@ StatsDialog::StatsDialog(): QDialog(), fdns_report_(0), fdns_seq_(0), fdns_fd_(0
 
 	connect(procView_,  SIGNAL(anchorClicked(const QUrl &)), this, SLOT(anchorClicked(const QUrl &)));
 
+	jobs_ = new JobQueue(this);
+	connect(jobs_, SIGNAL(finished(int, QByteArray)), this, SLOT(jobFinished(int, QByteArray)));
+
+	// graphs, two on each row under the text; the widgets are created on first use and reused
+	QWidget *panel = new QWidget;
+	graphLayout_ = new QGridLayout;
+	graphLayout_->setAlignment(Qt::AlignLeft | Qt::AlignTop);
+	panel->setLayout(graphLayout_);
+	graphArea_ = new QScrollArea;
+	graphArea_->setWidget(panel);
+	graphArea_->setWidgetResizable(true);
+	graphArea_->hide();
+	memset(graphs_, 0, sizeof(graphs_));
+
+	// top page: sandbox table under the navigation links
+	topHeader_ = new QLabel;
+	topHeader_->setTextFormat(Qt::RichText);
+	connect(topHeader_, SIGNAL(linkActivated(const QString &)), this, SLOT(linkActivated(const QString &)));
+	topModel_ = new SandboxModel(this);
+	QSortFilterProxyModel *sort = new QSortFilterProxyModel(this);
+	sort->setSourceModel(topModel_);
+	sort->setSortRole(Qt::UserRole);
+	sort->setDynamicSortFilter(true);
+	topView_ = new QTableView;
+	topView_->setModel(sort);
+	topView_->setSortingEnabled(true);
+	topView_->sortByColumn(SandboxModel::COL_PID, Qt::AscendingOrder);
+	topView_->setSelectionBehavior(QAbstractItemView::SelectRows);
+	topView_->setSelectionMode(QAbstractItemView::SingleSelection);
+	topView_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	topView_->setShowGrid(false);
+	topView_->setWordWrap(false);
+	topView_->verticalHeader()->hide();
+	topView_->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+	topView_->verticalHeader()->setDefaultSectionSize(topView_->fontMetrics().height() + 6);
+	topView_->horizontalHeader()->setStretchLastSection(true);
+	connect(topView_, SIGNAL(activated(const QModelIndex &)), this, SLOT(sandboxActivated(const QModelIndex &)));
+	topPage_ = new QWidget;
+	QVBoxLayout *topLayout = new QVBoxLayout;
+	topLayout->setContentsMargins(0, 0, 0, 0);
+	topLayout->addWidget(topHeader_);
+	topLayout->addWidget(topView_);
+	topPage_->setLayout(topLayout);
+
+	pages_ = new QStackedWidget;
+	pages_->addWidget(procView_);
+	pages_->addWidget(topPage_);
+	pages_->setCurrentWidget(procView_);
+
+	QSplitter *splitter = new QSplitter(Qt::Vertical);
+	splitter->addWidget(pages_);
+	splitter->addWidget(graphArea_);
 	QGridLayout *layout = new QGridLayout;
-	layout->addWidget(procView_, 0, 0);
+	layout->addWidget(splitter, 0, 0);
 	setLayout(layout);
 
 	// set screen size and title
@@ -211,6 +265,35 @@ StatsDialog::~StatsDialog() {
 		config_write_screen_size(width(), height());
 }
 
+// next graph widget in the graph panel
+GraphWidget *StatsDialog::nextGraph() {
+	assert(graph_cnt_ < MAX_GRAPHS);
+	if (!graphs_[graph_cnt_]) {
+		graphs_[graph_cnt_] = new GraphWidget;
+		graphLayout_->addWidget(graphs_[graph_cnt_], graph_cnt_ / 2, graph_cnt_ % 2);
+	}
+	graphs_[graph_cnt_]->show();
+	return graphs_[graph_cnt_++];
+}
+
+// the next graph starts a new row
+void StatsDialog::graphRow() {
+	if (graph_cnt_ % 2 == 0)
+		return;
+	if (graph_cnt_ < MAX_GRAPHS && graphs_[graph_cnt_])
+		graphs_[graph_cnt_]->hide();
+	graph_cnt_++;
+}
+
+// hide the graphs not used in this cycle, and the panel if there are none
+void StatsDialog::showGraphs() {
+	for (int i = graph_cnt_; i < MAX_GRAPHS; i++) {
+		if (graphs_[i])
+			graphs_[i]->hide();
+	}
+	graphArea_->setVisible(graph_cnt_ != 0);
+}
+
 void StatsDialog::cleanStorage() {
 	storage_dns_ = "";
 	storage_caps_ = "";
@@ -218,6 +301,7 @@ void StatsDialog::cleanStorage() {
 	storage_intro_ = "";
 	storage_network_ = "";
 	storage_netfilter_ = "";
+	storage_tree_ = "";
 }
 
 // Shutdown sequence
@@ -241,6 +325,27 @@ void StatsDialog::trayActivated(QSystemTrayIcon::ActivationReason reason) {
 		showNormal();
 }
 
+// sampling slows down while the window is hidden or minimized; there is no stats thread
+// if firejail is missing
+void StatsDialog::showEvent(QShowEvent *event) {
+	QDialog::showEvent(event);
+	if (thread_)
+		thread_->setVisible(true);
+	cycleReady();
+}
+
+void StatsDialog::hideEvent(QHideEvent *event) {
+	QDialog::hideEvent(event);
+	if (thread_)
+		thread_->setVisible(false);
+}
+
+void StatsDialog::changeEvent(QEvent *event) {
+	QDialog::changeEvent(event);
+	if (event->type() == QEvent::WindowStateChange && thread_)
+		thread_->setVisible(isVisible() && !isMinimized());
+}
+
 void StatsDialog::createTrayActions() {
 	minimizeAction = new QAction(tr("Mi&nimize"), this);
 	connect(minimizeAction, SIGNAL(triggered()), this, SLOT(hide()));
@@ -310,56 +415,18 @@ QString StatsDialog::header() {
 
 void StatsDialog::updateTop() {
 	timetrace_start();
-	QString msg = header();
-	msg += "<table><tr><td width=\"5\"></td><td><b>Sandbox List</b></td></tr></table><br/>\n";
-	msg += "<table><tr><td width=\"5\"></td><td width=\"60\">PID</td/><td width=\"60\">CPU<br/>(%)</td><td>Memory<br/>(KiB)&nbsp;&nbsp;</td><td>RX<br/>(KB/s)&nbsp;&nbsp;</td><td>TX<br/>(KB/s)&nbsp;&nbsp;</td><td>Command</td>\n";
-
-	int cycle = Db::instance().getCycle();
-	assert(cycle < DbPid::MAXCYCLE);
-	DbPid *ptr = Db::instance().firstPid();
-
-	while (ptr) {
-		pid_t pid = ptr->getPid();
-		const char *cmd = ptr->getCmd();
-
-		if (pid != SYSTEM_PID && cmd) {
-			if (arg_debug)
-				printf("pid %d, netnamespace %d, netnone %d - %s\n", pid, ptr->netNamespace(), ptr->netNone(), cmd);
-			char *str;
-			DbStorage *st = &ptr->data_1min_[cycle];
-			if (ptr->netNone()) {
-				if (asprintf(&str, "<tr><td></td><td><a href=\"%d\">%d</a></td><td>%.02f</td><td>%d</td><td>no network</td><td></td><td>%s</td></tr>",
-					pid, pid, st->cpu_, (int) (st->rss_ + st->shared_),
-					cmd) != -1) {
-						msg += str;
-				}
-			}
-			else if (ptr->netNamespace()) {
-				if (asprintf(&str, "<tr><td></td><td><a href=\"%d\">%d</a></td><td>%.02f</td><td>%d</td><td>%.02f</td><td>%.02f</td><td>%s</td></tr>",
-					pid, pid, st->cpu_, (int) (st->rss_ + st->shared_),
-					st->rx_, st->tx_, cmd) != -1) {
-						msg += str;
-					}
-			}
-			else {
-				if (asprintf(&str, "<tr><td></td><td><a href=\"%d\">%d</a></td><td>%.02f</td><td>%d</td><td>system</td><td></td><td>%s</td></tr>",
-					pid, pid, st->cpu_, (int) (st->rss_ + st->shared_),
-					cmd) != -1) {
-						msg += str;
-				}
-			}
-			free(str);
-		}
-
-		ptr = ptr->getNext();
-	}
-
-	msg += "</table><br/><br/><br/>";
-	msg += "<b>System Network</b><br/>";
-	DbPid *dbpid = Db::instance().findPid(SYSTEM_PID);
-	msg += "<table><tr><td></td><td>"+ graph(2, dbpid, cycle, GRAPH_1MIN) + "</td><td></td>&nbsp;&nbsp;<td>" + graph(3, dbpid, cycle, GRAPH_1MIN) + "</td></tr></table>";
-
-	procView_->setHtml(msg);
+	QString msg = header() + "<table><tr><td width=\"5\"></td><td><b>Sandbox List</b></td></tr></table>";
+	if (topHeader_->text() != msg)
+		topHeader_->setText(msg);
+	topModel_->update(snap_);
+
+	// system network and pressure
+	DbPid *dbpid = snap_->findPid(SYSTEM_PID);
+	nextGraph()->setGraph(2, dbpid, snap_, GRAPH_1MIN);
+	nextGraph()->setGraph(3, dbpid, snap_, GRAPH_1MIN);
+	nextGraph()->setGraph(16, dbpid, snap_, GRAPH_1MIN);
+	nextGraph()->setGraph(17, dbpid, snap_, GRAPH_1MIN);
+	nextGraph()->setGraph(18, dbpid, snap_, GRAPH_1MIN);
 	float delta = timetrace_end();
 	if (arg_debug)
 		printf("updateTop %.02f ms\n", delta);
@@ -547,193 +614,98 @@ void StatsDialog::updateFdns() {
 
 
 void StatsDialog::updateFirewall() {
-	DbPid *dbptr = Db::instance().findPid(pid_);
+	DbPid *dbptr = snap_->findPid(pid_);
 	if (!dbptr) {
 		mode_ = MODE_TOP;
 		return;
 	}
 
-	QString msg = storage_netfilter_;
-	if (msg.isEmpty()) {
+	// the page is set in jobFinished()
+	if (storage_netfilter_.isEmpty()) {
 		if (arg_debug)
 			printf("reading firewall configuration\n");
-		msg = header() + storage_intro_;
-
-		char *cmd;
-		if (asprintf(&cmd, "firejail --netfilter.print=%d", pid_) != -1) {
-			char *str = run_program(cmd);
-			if (str)
-				msg += "<pre>" + QString(str) + "</pre>";
-		}
-		storage_netfilter_ = msg;
-		procView_->setHtml(msg);
+		submitJob(JOB_NETFILTER, "firejail --netfilter.print=%d");
+		procView_->setHtml(header() + storage_intro_ + JOB_PLACEHOLDER);
 	}
 }
 
 
 void StatsDialog::updateTree() {
-	DbPid *dbptr = Db::instance().findPid(pid_);
+	DbPid *dbptr = snap_->findPid(pid_);
 	if (!dbptr) {
 		mode_ = MODE_TOP;
 		return;
 	}
 
-	if (arg_debug)
-		printf("reading process tree configuration\n");
+	// refreshed as often as firemon answers
+	submitJob(JOB_TREE, "firemon --tree --wrap %d");
 	QString msg = header() + storage_intro_;
 	msg += "<table><tr><td width=\"5\"></td><td>";
-
-	char *str = 0;
-	char *cmd;
-	if (asprintf(&cmd, "firemon --tree --wrap %d", pid_) != -1) {
-		str = run_program(cmd);
-		char *ptr = str;
-		// htmlize!
-		while (*ptr != 0) {
-			if (*ptr == '\n') {
-				*ptr = '\0';
-				msg += QString(str) + "<br/>\n";
-				ptr++;
-
-				while (*ptr == ' ') {
-					msg += "&nbsp;&nbsp;";
-					ptr++;
-				}
-				str = ptr;
-				continue;
-			}
-			ptr++;
-		}
-		free(cmd);
-	}
-
+	msg += (storage_tree_.isEmpty())? QString(JOB_PLACEHOLDER): storage_tree_;
 	msg += "</td></tr></table>";
 	procView_->setHtml(msg);
 }
 
 
 void StatsDialog::updateSeccomp() {
-	DbPid *dbptr = Db::instance().findPid(pid_);
+	DbPid *dbptr = snap_->findPid(pid_);
 	if (!dbptr) {
 		mode_ = MODE_TOP;
 		return;
 	}
 
-	QString msg = storage_seccomp_;
-	if (msg.isEmpty()) {
+	// the page is set in jobFinished()
+	if (storage_seccomp_.isEmpty()) {
 		if (arg_debug)
 			printf("reading seccomp configuration\n");
-		QString msg = header() + storage_intro_;
-		msg += "<table><tr><td width=\"5\"></td><td>";
-
-		char *str = 0;
-		char *cmd;
-		if (asprintf(&cmd, "firejail --seccomp.print=%d", pid_) != -1) {
-			str = run_program(cmd);
-			char *ptr = str;
-			// htmlize!
-			while (*ptr != 0) {
-				if (*ptr == '\n') {
-					*ptr = '\0';
-					msg += QString(str) + "<br/>\n";
-					ptr++;
-
-					while (*ptr == ' ') {
-						msg += "&nbsp;&nbsp;";
-						ptr++;
-					}
-					str = ptr;
-					continue;
-				}
-				ptr++;
-			}
-			free(cmd);
-		}
-
-		msg += "</td></tr></table>";
-		procView_->setHtml(msg);
-		storage_seccomp_ = msg;
+		submitJob(JOB_SECCOMP_PRINT, "firejail --seccomp.print=%d");
+		procView_->setHtml(header() + storage_intro_ + JOB_PLACEHOLDER);
 	}
 }
 
 
 void StatsDialog::updateCaps() {
-	DbPid *dbptr = Db::instance().findPid(pid_);
+	DbPid *dbptr = snap_->findPid(pid_);
 	if (!dbptr) {
 		mode_ = MODE_TOP;
 		return;
 	}
 
-	QString msg = storage_caps_;
-	if (msg.isEmpty()) {
+	// the page is set in jobFinished()
+	if (storage_caps_.isEmpty()) {
 		if (arg_debug)
 			printf("reading caps configuration\n");
-		msg = header() + storage_intro_;
-		msg += "<table><tr><td width=\"5\"></td><td>";
-
-		char *str = 0;
-		char *cmd;
-		if (asprintf(&cmd, "firejail --caps.print=%d", pid_) != -1) {
-			str = run_program(cmd);
-			char *ptr = str;
-			// htmlize!
-			int cnt = 0;
-			while (*ptr != 0) {
-				if (*ptr == '\n') {
-					// print only caps supported by the current kernel
-					if (cnt >= caps_cnt_)
-						break;
-					cnt++;
-
-					*ptr = '\0';
-					msg += QString(str) + "<br/>\n";
-					ptr++;
-					str = ptr;
-					continue;
-				}
-				ptr++;
-			}
-			free(cmd);
-		}
-
-		msg += "</pre></td></tr></table>";
-		procView_->setHtml(msg);
-		storage_caps_ = msg;
+		submitJob(JOB_CAPS_PRINT, "firejail --caps.print=%d");
+		procView_->setHtml(header() + storage_intro_ + JOB_PLACEHOLDER);
 	}
 }
 
-static QString get_dns(int pid) {
+// firejail --dns.print output
+static QString get_dns(char *str) {
 	QString rv;
+	char *ptr = str;
 
-	char *str = 0;
-	char *cmd;
-	if (asprintf(&cmd, "firejail --dns.print=%d", pid) != -1) {
-		str = run_program(cmd);
-		char *ptr = str;
+	// htmlize!
+	while (*ptr != 0) {
+		if (*ptr == '\n') {
+			*ptr = '\0';
+			bool skip = false;
+			if (*str == '#')
+				skip = true;
+			if (!skip)
+				rv += QString(str) + "<br/>\n";
+			ptr++;
 
-		// htmlize!
-		while (*ptr != 0) {
-			if (*ptr == '\n') {
-				*ptr = '\0';
-				bool skip = false;
-				if (*str == '#')
-					skip = true;
+			while (*ptr == ' ') {
 				if (!skip)
-					rv += QString(str) + "<br/>\n";
+					rv += "&nbsp;&nbsp;";
 				ptr++;
-
-				while (*ptr == ' ') {
-					if (!skip)
-						rv += "&nbsp;&nbsp;";
-					ptr++;
-				}
-				str = ptr;
-				continue;
 			}
-			ptr++;
+			str = ptr;
+			continue;
 		}
+		ptr++;
 	}
-	free(cmd);
 	return rv;
 }
 
@@ -786,75 +758,68 @@ static QString get_interfaces_old(int pid) {
 	return rv;
 }
 
-// build the network interface list for firejail versions 0.9.57 and up
+// build the network interface list for firejail versions 0.9.57 and up from firejail --net.print output
 // returns an empty string if --net.print is not available in the currently installed firejail version
-static QString get_interfaces_new(int pid) {
+static QString get_interfaces_new(char *str) {
 	QString rv;
-	char *str = 0;
-	char *cmd;
-	if (asprintf(&cmd, "firejail --net.print=%d 2>&1", pid) != -1) {
-		str = run_program(cmd);
-		free(cmd);
-
-		// htmlize!
-		char *ptr = strtok(str, "\n");
-		if (!ptr || strncmp(ptr, "Error", 5) == 0)
+	// htmlize!
+	char *ptr = strtok(str, "\n");
+	if (!ptr || strncmp(ptr, "Error", 5) == 0)
+		goto errexit;
+	while ((ptr = strtok(NULL, "\n")) != NULL) {
+		if (strncmp(ptr, "Error", 5) == 0)
 			goto errexit;
-		while ((ptr = strtok(NULL, "\n")) != NULL) {
-			if (strncmp(ptr, "Error", 5) == 0)
-				goto errexit;
-			if (strncmp(ptr, "Interface ", 10) == 0)
-				continue;
-			if (strncmp(ptr, "lo ", 3) == 0)
-				continue;
+		if (strncmp(ptr, "Interface ", 10) == 0)
+			continue;
+		if (strncmp(ptr, "lo ", 3) == 0)
+			continue;
 
-			// parse the interface line, example
-			//eth0-12202       c6:7f:d1:a9:3d:bc  192.168.1.82     255.255.255.0    UP
-			// ifname
-			char *ifname = ptr;
-			while (*ptr != ' ' && *ptr != '\0')
-				ptr++;
-			if (*ptr == '\0')
-				goto errexit;
-			*ptr = '\0';
+		// parse the interface line, example
+		//eth0-12202       c6:7f:d1:a9:3d:bc  192.168.1.82     255.255.255.0    UP
+		// ifname
+		char *ifname = ptr;
+		while (*ptr != ' ' && *ptr != '\0')
 			ptr++;
+		if (*ptr == '\0')
+			goto errexit;
+		*ptr = '\0';
+		ptr++;
 
-			// skip mac address
-			while (*ptr == ' ')
-				ptr++;
-			while (*ptr != ' ' && *ptr != '\0')
-				ptr++;
-			if (*ptr == '\0')
-				goto errexit;
-			while (*ptr == ' ')
-				ptr++;
+		// skip mac address
+		while (*ptr == ' ')
+			ptr++;
+		while (*ptr != ' ' && *ptr != '\0')
+			ptr++;
+		if (*ptr == '\0')
+			goto errexit;
+		while (*ptr == ' ')
+			ptr++;
 
-			// ip address
-			char *ip = ptr;
-			while (*ptr != ' ' && *ptr != '\0')
-				ptr++;
-			if (*ptr == '\0')
-				goto errexit;
-			*ptr = '\0';
+		// ip address
+		char *ip = ptr;
+		while (*ptr != ' ' && *ptr != '\0')
+			ptr++;
+		if (*ptr == '\0')
+			goto errexit;
+		*ptr = '\0';
+		ptr++;
+		while (*ptr == ' ')
 			ptr++;
-			while (*ptr == ' ')
-				ptr++;
 
-			// extract mask...
-			char *mask	= ptr;
-			while (*ptr != ' ' && *ptr != '\0')
-				ptr++;
-			if (*ptr == '\0')
-				goto errexit;
-			*ptr = '\0';
-			// ... and build a CIDR addrss
-			uint32_t mask_uint32;
-			if (atoip(mask, &mask_uint32))
-				goto errexit;
-			int bits = mask2bits(mask_uint32);
-			rv += QString(ifname) + "&nbsp;&nbsp;&nbsp;" + QString(ip) + "/" +
-				QString::number(bits) + "<br/>";
-		}
+		// extract mask...
+		char *mask	= ptr;
+		while (*ptr != ' ' && *ptr != '\0')
+			ptr++;
+		if (*ptr == '\0')
+			goto errexit;
+		*ptr = '\0';
+		// ... and build a CIDR addrss
+		uint32_t mask_uint32;
+		if (atoip(mask, &mask_uint32))
+			goto errexit;
+		int bits = mask2bits(mask_uint32);
+		rv += QString(ifname) + "&nbsp;&nbsp;&nbsp;" + QString(ip) + "/" +
+			QString::number(bits) + "<br/>";
 	}
 
 	return rv;
@@ -864,9 +829,9 @@ errexit:
 }
 
 void StatsDialog::updateNetwork() {
-	int cycle = Db::instance().getCycle();
+	int cycle = snap_->getCycle();
 	assert(cycle < DbPid::MAXCYCLE);
-	DbPid *dbptr = Db::instance().findPid(pid_);
+	DbPid *dbptr = snap_->findPid(pid_);
 	if (!dbptr) {
 		mode_ = MODE_TOP;
 		return;
@@ -877,52 +842,36 @@ void StatsDialog::updateNetwork() {
 	if (storage_dns_.isEmpty()) {
 		if (arg_debug)
 			printf("reading dns configuration\n");
-
-		storage_dns_ += "<table><tr><td width=\"5\"></td><td><b>DNS</b><br/>";
-		storage_dns_ += get_dns(pid_);
-		storage_dns_ += "</td>";
+		submitJob(JOB_DNS, "firejail --dns.print=%d");
+		msg += QString("<table><tr><td width=\"5\"></td><td><b>DNS</b><br/>") + JOB_PLACEHOLDER + "</td>";
 	}
-	msg += storage_dns_;
+	else
+		msg += storage_dns_;
 
-	// network interfaces
+	// network interfaces; in a network namespace they are set in jobFinished()
 	if (storage_network_.isEmpty()) {
-		if (net_none_)
-			storage_network_ = "<td><b>Network Interfaces</b><br/>lo<br/>";
+		if (dbptr->netNone())
+			storage_network_ = "<td><b>Network Interfaces</b><br/>lo<br/></td></tr>";
 		else if (dbptr->netNamespace() == false)
-			storage_network_ = "<td>Using the system network namespace";
-		else {
-
-			storage_network_ = "<td><b>Network Interfaces</b><br/>lo<br/>";
-			QString tmp = get_interfaces_new(pid_);
-			if (tmp.isEmpty())
-				tmp = get_interfaces_old(pid_);
-			storage_network_ += tmp;
-		}
-		storage_network_ += "</td></tr>";
-
+			storage_network_ = "<td>Using the system network namespace</td></tr>";
+		else
+			submitJob(JOB_NET, "firejail --net.print=%d 2>&1");
 	}
-	msg += storage_network_;
+	if (storage_network_.isEmpty())
+		msg += QString("<td><b>Network Interfaces</b><br/>lo<br/>") + JOB_PLACEHOLDER + "</td></tr>";
+	else
+		msg += storage_network_;
 
 
 
 	// graph type
 	msg += "<tr><td></td>";
-	if (dbptr->netNamespace() == true && net_none_ == false) {
-		if (graph_type_ == GRAPH_1MIN) {
-			msg += "<td><b>Stats: </b>1min <a href=\"1h\">1h</a> <a href=\"12h\">12h</a></td>";
-		}
-		else if (graph_type_ == GRAPH_1H) {
-			msg += "<td><b>Stats: </b><a href=\"1min\">1min</a> 1h <a href=\"12h\">12h</a></td>";
-		}
-		else if (graph_type_ == GRAPH_12H) {
-			msg += "<td><b>Stats: </b><a href=\"1min\">1min</a> <a href=\"1h\">1h</a> 12h</td>";
-		}
-		else
-			assert(0);
+	if (dbptr->netNamespace() == true && dbptr->netNone() == false) {
+		msg += "<td>" + graph_links(graph_type_) + "</td>";
 	}
 
 	// netfilter
-	if (dbptr->netNamespace() == true && net_none_ == false)
+	if (dbptr->netNamespace() == true && dbptr->netNone() == false)
 		msg += "<td><b>Firewall</b>: <a href=\"firewall\">enabled</a></td></tr>\n";
 	else if (dbptr->netNone() == true)
 		msg += "<td><b>Firewall</b>: no firewall</td></tr>\n";
@@ -930,13 +879,31 @@ void StatsDialog::updateNetwork() {
 		msg += "<td><b>Firewall</b>: system firewall</td></tr>\n";
 
 
-	if (dbptr->netNamespace() == true && net_none_ == false)
-		msg += "<tr><td></td><td>"+ graph(2, dbptr, cycle, graph_type_) + "</td><td>" + graph(3, dbptr, cycle, graph_type_) + "</td></tr>";
+	if (dbptr->netNamespace() == true && dbptr->netNone() == false) {
+		nextGraph()->setGraph(2, dbptr, snap_, graph_type_);
+		nextGraph()->setGraph(3, dbptr, snap_, graph_type_);
+
+		// per interface
+		for (int i = 0; i < dbptr->netIfCnt(); i++) {
+			DbNetIf *netif = dbptr->netIf(i);
+			DbNetStorage row = netif->data_1min_.get(cycle);
+			DbNetStorage *data = &row;
+			msg += QString("<tr><td></td><td colspan=\"2\"><b>") + netif->name_ + "</b>: ";
+			msg += QString::number(data->rx_packets_, 'f', 1) + " RX packets/s, ";
+			msg += QString::number(data->tx_packets_, 'f', 1) + " TX packets/s, ";
+			msg += QString::number(data->drops_, 'f', 1) + " drops/s</td></tr>";
+			// the archive keeps only the sandbox totals
+			if (graph_type_ != GRAPH_ARCHIVE) {
+				nextGraph()->setGraph(0, netif, snap_, graph_type_);
+				nextGraph()->setGraph(1, netif, snap_, graph_type_);
+			}
+		}
+	}
 
 	msg += QString("</table><br/>");
 
 	// bandwidth limits
-	if (dbptr->netNamespace() == true && net_none_ == false) {
+	if (dbptr->netNamespace() == true && dbptr->netNone() == false) {
 		char *fname;
 		if (asprintf(&fname, "/run/firejail/bandwidth/%d-bandwidth", pid_) == -1)
 			errExit("asprintf");
@@ -959,100 +926,200 @@ void StatsDialog::updateNetwork() {
 
 }
 
-void StatsDialog::kernelSecuritySettings() {
+// the settings are filled in by jobFinished(), JOB_PLACEHOLDER until then; child is the sandboxed
+// process from the database snapshot
+void StatsDialog::kernelSecuritySettings(pid_t child) {
 	if (arg_debug)
 		printf("Checking security settings for pid %d\n", pid_);
 
 	// reset all
 	pid_seccomp_ = false;
-	pid_caps_ = QString("");
-	pid_cpu_cores_ = QString("");
-	pid_protocol_ = QString("");
-	pid_mem_deny_exec_ = QString("disabled");
+	pid_caps_ = QString(JOB_PLACEHOLDER);
+	pid_cpu_cores_ = QString(JOB_PLACEHOLDER);
+	pid_protocol_ = QString(JOB_PLACEHOLDER);
+	pid_mem_deny_exec_ = QString(JOB_PLACEHOLDER);
 	pid_apparmor_ = QString("");
 
-	// caps
-	char *cmd;
-	if (asprintf(&cmd, "firemon --caps %d", pid_) == -1)
+	// capabilities, seccomp and cpus are read directly from /proc; firemon is used only if
+	// the status file of the sandboxed process is not accessible
+	SandboxInspect si;
+	if (inspect_sandbox(child, &si) == 0) {
+		pid_caps_ = QString(si.caps);
+		pid_seccomp_ = (si.seccomp == 2);
+		pid_cpu_cores_ = QString(si.cpus);
+	}
+	else {
+		if (arg_debug)
+			printf("Cannot inspect sandbox %d, using firemon\n", pid_);
+		submitJob(JOB_CAPS, "firemon --caps %d");
+		submitJob(JOB_SECCOMP, "firemon --seccomp %d");
+		submitJob(JOB_CPU, "firemon --cpu %d");
+	}
+	submitJob(JOB_PROTOCOL, "firejail --protocol.print=%d");
+	submitJob(JOB_MDWX, "firejail --ls=%d /run/firejail/mnt");
+	submitJob(JOB_APPARMOR, "firejail --apparmor.print=%d");
+}
+
+// queue a query about the current sandbox, fmt has a %d for the pid; nothing is done if the same
+// query is already running
+void StatsDialog::submitJob(int job, const char *fmt) {
+	if (jobs_pending_ & (1u << job))
 		return;
-	char *str = run_program(cmd);
-	if (str) {
+	char *cmd;
+	if (asprintf(&cmd, fmt, pid_) == -1)
+		errExit("asprintf");
+	jobs_->submit(job, cmd);
+	jobs_pending_ |= 1u << job;
+	free(cmd);
+}
+
+void StatsDialog::cancelJobs() {
+	jobs_->cancel();
+	jobs_pending_ = 0;
+}
+
+void StatsDialog::jobFinished(int job, QByteArray output) {
+	jobs_pending_ &= ~(1u << job);
+	char *str = output.data();
+
+	if (job == JOB_CAPS) {
 		char *ptr = strstr(str, "CapBnd:");
 		if (ptr)
 			pid_caps_ = QString(ptr + 7);
 		else
 			pid_caps_ = QString("");
 	}
-	free(cmd);
-
-	// seccomp
-	if (asprintf(&cmd, "firemon --seccomp %d", pid_) == -1)
-		return;
-	str = run_program(cmd);
-	if (str) {
+	else if (job == JOB_SECCOMP) {
 		char *ptr = strstr(str, "Seccomp");
 		if (ptr) {
 			if (strstr(ptr, "2"))
 				pid_seccomp_ = true;
 		}
 	}
-	free(cmd);
-
-	// cpu cores
-	if (asprintf(&cmd, "firemon --cpu %d", pid_) == -1)
-		return;
-	str = run_program(cmd);
-	if (str) {
+	else if (job == JOB_CPU) {
+		pid_cpu_cores_ = QString("");
 		char *ptr = strstr(str, "Cpus_allowed_list:");
 		if (ptr) {
 			ptr += 18;
 			pid_cpu_cores_ = QString(ptr);
 		}
 	}
-	free(cmd);
-
-	// protocols
-	if (asprintf(&cmd, "firejail --protocol.print=%d", pid_) == -1)
-		return;
-
-	str = run_program(cmd);
-	if (str) {
+	else if (job == JOB_PROTOCOL) {
 		if (strncmp(str, "Cannot", 6) == 0)
 			pid_protocol_ = QString("disabled");
 		else
 			pid_protocol_ = QString(str);
 	}
-	free(cmd);
-
-	// mem deny exec
-	if (asprintf(&cmd, "firejail --ls=%d /run/firejail/mnt", pid_) == -1)
-		return;
-	str = run_program(cmd);
-	if (str) {
+	else if (job == JOB_MDWX) {
 		if (strstr(str, "seccomp.mdwx"))
 			pid_mem_deny_exec_ = "enabled";
+		else
+			pid_mem_deny_exec_ = "disabled";
 	}
-	free(cmd);
-
-	// apparmor
-	if (asprintf(&cmd, "firejail --apparmor.print=%d", pid_) == -1)
-		return;
-	str = run_program(cmd);
-	if (str) {
+	else if (job == JOB_APPARMOR) {
 		const char *tofind = "AppArmor: ";
 		char *ptr = strstr(str, tofind);
 		if (ptr)
 			pid_apparmor_ = QString(ptr + strlen(tofind));
 	}
-	free(cmd);
+	else if (job == JOB_TREE) {
+		storage_tree_ = "";
+		char *ptr = str;
+		// htmlize!
+		while (*ptr != 0) {
+			if (*ptr == '\n') {
+				*ptr = '\0';
+				storage_tree_ += QString(str) + "<br/>\n";
+				ptr++;
+
+				while (*ptr == ' ') {
+					storage_tree_ += "&nbsp;&nbsp;";
+					ptr++;
+				}
+				str = ptr;
+				continue;
+			}
+			ptr++;
+		}
+	}
+	else if (job == JOB_SECCOMP_PRINT) {
+		QString msg = header() + storage_intro_;
+		msg += "<table><tr><td width=\"5\"></td><td>";
+		char *ptr = str;
+		// htmlize!
+		while (*ptr != 0) {
+			if (*ptr == '\n') {
+				*ptr = '\0';
+				msg += QString(str) + "<br/>\n";
+				ptr++;
+
+				while (*ptr == ' ') {
+					msg += "&nbsp;&nbsp;";
+					ptr++;
+				}
+				str = ptr;
+				continue;
+			}
+			ptr++;
+		}
+		msg += "</td></tr></table>";
+		storage_seccomp_ = msg;
+		if (mode_ == MODE_SECCOMP)
+			procView_->setHtml(msg);
+	}
+	else if (job == JOB_CAPS_PRINT) {
+		QString msg = header() + storage_intro_;
+		msg += "<table><tr><td width=\"5\"></td><td>";
+		char *ptr = str;
+		// htmlize!
+		int cnt = 0;
+		while (*ptr != 0) {
+			if (*ptr == '\n') {
+				// print only caps supported by the current kernel
+				if (cnt >= caps_cnt_)
+					break;
+				cnt++;
+
+				*ptr = '\0';
+				msg += QString(str) + "<br/>\n";
+				ptr++;
+				str = ptr;
+				continue;
+			}
+			ptr++;
+		}
+		msg += "</pre></td></tr></table>";
+		storage_caps_ = msg;
+		if (mode_ == MODE_CAPS)
+			procView_->setHtml(msg);
+	}
+	else if (job == JOB_NETFILTER) {
+		QString msg = header() + storage_intro_;
+		msg += "<pre>" + QString(str) + "</pre>";
+		storage_netfilter_ = msg;
+		if (mode_ == MODE_FIREWALL)
+			procView_->setHtml(msg);
+	}
+	else if (job == JOB_DNS)
+		storage_dns_ = "<table><tr><td width=\"5\"></td><td><b>DNS</b><br/>" + get_dns(str) + "</td>";
+	else if (job == JOB_NET) {
+		QString tmp = get_interfaces_new(str);
+		if (tmp.isEmpty())
+			tmp = get_interfaces_old(pid_);
+		storage_network_ = "<td><b>Network Interfaces</b><br/>lo<br/>" + tmp + "</td></tr>";
+	}
+
+	// the pages rendered every cycle show the result right away
+	if (mode_ == MODE_PID || mode_ == MODE_TREE || mode_ == MODE_NETWORK)
+		cycleReady();
 }
 
 void StatsDialog::updatePid() {
 	QString msg = "";
 
-	int cycle = Db::instance().getCycle();
+	int cycle = snap_->getCycle();
 	assert(cycle < DbPid::MAXCYCLE);
-	DbPid *ptr = Db::instance().findPid(pid_);
+	DbPid *ptr = snap_->findPid(pid_);
 	if (!ptr) {
 		mode_ = MODE_TOP;
 		return;
@@ -1066,35 +1133,17 @@ void StatsDialog::updatePid() {
 
 	// initialize static values
 	if (pid_initialized_ == false) {
-		kernelSecuritySettings();
-		pid_noroot_ = userNamespace(pid_);
+		kernelSecuritySettings(ptr->getChild());
+		pid_noroot_ = userNamespace(ptr->getChild());
 		pid_name_ = getName(pid_);
 		profile_ = getProfile(pid_);
 		pid_x11_ = getX11Display(pid_);
 		pid_initialized_ = true;
-
-		// detect --net=none
-		int child = pid_find_child(pid_);
-		char *fname;
-		if (asprintf(&fname, "/proc/%d/net/dev", child) == -1)
-			errExit("asprintf");
-		FILE *fp = fopen(fname, "r");
-		if (fp) {
-			char buf[4096];
-			int cnt = 0;
-			while (fgets(buf, 4096, fp))
-				cnt++;
-			fclose(fp);
-			if (cnt <= 3)
-				net_none_ = true;
-			else
-				net_none_ = false;
-		}
-		free(fname);
 	}
 
 	// get user name
-	DbStorage *st = &ptr->data_1min_[cycle];
+	DbStorage row = ptr->data_1min_.get(cycle);
+	DbStorage *st = &row;
 	struct passwd *pw = getpwuid(ptr->getUid());
 	if (!pw)
 		errExit("getpwuid");
@@ -1116,7 +1165,7 @@ void StatsDialog::updatePid() {
 	msg += "<table>";
 	msg += QString("<tr><td width=\"5\"></td><td><b>PID:</b> ") +  QString::number(pid_) + "</td>";
 	if (ptr->netNamespace() == false) {
-		QString net = (net_none_)? " no network": " system";
+		QString net = (ptr->netNone())? " no network": " system";
 		msg += "<td><b>RX:</b> " + net + "</td></tr>";
 	}
 	else
@@ -1124,7 +1173,7 @@ void StatsDialog::updatePid() {
 
 	msg += QString("<tr><td></td><td><b>User:</b> ") + pw->pw_name  + "</td>";
 	if (ptr->netNamespace() == false) {
-		QString net = (net_none_)? " no network": " system";
+		QString net = (ptr->netNone())? " no network": " system";
 		msg += "<td><b>TX:</b> " + net + "</td></tr>";
 	}
 	else
@@ -1132,16 +1181,24 @@ void StatsDialog::updatePid() {
 
 	msg += QString("<tr><td></td><td><b>CPU:</b> ") + QString::number(st->cpu_) + "%</td>";
 	msg += QString("<td><b>Seccomp:</b> ");
-	if (pid_seccomp_)
+	if (jobs_pending_ & (1u << JOB_SECCOMP))
+		msg += JOB_PLACEHOLDER;
+	else if (pid_seccomp_)
 		msg += "<a href=\"seccomp\">enabled</a>";
 	else
 		msg += "disabled";
 	msg += "</td></tr>";
 
-	msg += QString("<tr><td></td><td><b>Memory:</b> ") + QString::number((int) (st->rss_ + st->shared_)) + " KiB&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;</td>";
+	int mem = (arg_pss)? (int) st->pss_: (int) (st->rss_ + st->shared_);
+	msg += QString("<tr><td></td><td><b>Memory:</b> ") + QString::number(mem) + " KiB&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;</td>";
 	msg += QString("<td><b>Capabilities:</b> <a href=\"caps\">") + pid_caps_ + "</a></td></tr>";
 
 	msg += QString("<tr><td></td><td><b>RSS</b> " + QString::number((int) st->rss_) + ", <b>shared</b> " + QString::number((int) st->shared_)) + "</td>";
+	if (arg_pss) {
+		msg += "<td></td></tr>";
+		msg += QString("<tr><td></td><td><b>PSS</b> " + QString::number((int) st->pss_) + ", <b>USS</b> " + QString::number((int) st->uss_) +
+			", <b>swap</b> " + QString::number((int) st->swap_)) + "</td>";
+	}
 
 	// user namespace
 	msg += "<td><b>User Namespace:</b> ";
@@ -1153,12 +1210,23 @@ void StatsDialog::updatePid() {
 	msg += "</td></tr>";
 
 	msg += QString("<tr><td></td><td><b>CPU Cores:</b> ") + pid_cpu_cores_ + "</td>";
-	if (pid_seccomp_)
+	if (pid_seccomp_ || (jobs_pending_ & (1u << JOB_SECCOMP)))
 		msg += QString("<td><b>Protocols:</b> ") + pid_protocol_ + "</td>";
 	else
 		msg += QString("<td><b>Protocols:</b> disabled</td>");
 	msg += "</td></tr>";
 
+	msg += QString("<tr><td></td><td><b>Disk:</b> read ") + QString::number(st->io_read_) + " KB/s, write " +
+		QString::number(st->io_write_) + " KB/s</td><td></td></tr>";
+	msg += QString("<tr><td></td><td><b>CPU wait:</b> ") + QString::number(st->cpu_wait_) + " ms/s, <b>context switches:</b> " +
+		QString::number((int) st->ctxsw_) + "/s (" + QString::number((int) st->nvctxsw_) + " involuntary)</td><td></td></tr>";
+	msg += QString("<tr><td></td><td><b>Page faults:</b> ") + QString::number((int) st->majflt_) + " major/s, " +
+		QString::number((int) st->minflt_) + " minor/s</td><td></td></tr>";
+	if (ptr->getCgroup()) {
+		msg += QString("<tr><td></td><td><b>Pressure:</b> CPU ") + QString::number(st->psi_cpu_, 'f', 2) + "%, memory " +
+			QString::number(st->psi_mem_, 'f', 2) + "%, I/O " + QString::number(st->psi_io_, 'f', 2) + "%</td><td></td></tr>";
+	}
+
 	msg += "<tr><td></td>";
 
 	// X11 display
@@ -1180,21 +1248,30 @@ void StatsDialog::updatePid() {
 	// graph type
 	msg += "<tr></tr>";
 	msg += "<tr><td></td>";
-	if (graph_type_ == GRAPH_1MIN) {
-		msg += "<td><b>Stats: </b>1min <a href=\"1h\">1h</a> <a href=\"12h\">12h</a></td>";
-	}
-	else if (graph_type_ == GRAPH_1H) {
-		msg += "<td><b>Stats: </b><a href=\"1min\">1min</a> 1h <a href=\"12h\">12h</a></td>";
+	msg += "<td>" + graph_links(graph_type_) + "</td>";
+
+	// graphs, the related ones side by side
+	nextGraph()->setGraph(0, ptr, snap_, graph_type_);
+	nextGraph()->setGraph(1, ptr, snap_, graph_type_);
+	if (arg_pss) {
+		nextGraph()->setGraph(4, ptr, snap_, graph_type_);
+		nextGraph()->setGraph(5, ptr, snap_, graph_type_);
+		nextGraph()->setGraph(6, ptr, snap_, graph_type_);
+		graphRow();
+	}
+	nextGraph()->setGraph(7, ptr, snap_, graph_type_);
+	nextGraph()->setGraph(8, ptr, snap_, graph_type_);
+	nextGraph()->setGraph(9, ptr, snap_, graph_type_);
+	nextGraph()->setGraph(10, ptr, snap_, graph_type_);
+	nextGraph()->setGraph(11, ptr, snap_, graph_type_);
+	nextGraph()->setGraph(12, ptr, snap_, graph_type_);
+	nextGraph()->setGraph(15, ptr, snap_, graph_type_);
+	nextGraph()->setGraph(14, ptr, snap_, graph_type_);
+	if (ptr->getCgroup()) {
+		nextGraph()->setGraph(16, ptr, snap_, graph_type_);
+		nextGraph()->setGraph(17, ptr, snap_, graph_type_);
+		nextGraph()->setGraph(18, ptr, snap_, graph_type_);
 	}
-	else if (graph_type_ == GRAPH_12H) {
-		msg += "<td><b>Stats: </b><a href=\"1min\">1min</a> <a href=\"1h\">1h</a> 12h</td>";
-	}
-	else
-		assert(0);
-
-	// graphs
-	msg += "<tr></tr>";
-	msg += "<tr><td></td><td>"+ graph(0, ptr, cycle, graph_type_) + "</td><td>" + graph(1, ptr, cycle, graph_type_) + "</td></tr>";
 
 	msg += QString("</table><br/>");
 
@@ -1202,6 +1279,18 @@ void StatsDialog::updatePid() {
 }
 
 void StatsDialog::cycleReady() {
+	// nobody is looking
+	if (!isVisible() || isMinimized())
+		return;
+
+	// render the last published cycle; it is not released by the stats thread until we are done
+	snap_ = Db::instance().acquire();
+	if (!snap_) {
+		Db::instance().release();
+		return;
+	}
+	graph_cnt_ = 0;
+
 	if (mode_ == MODE_TOP)
 		updateTop();
 	else if (mode_ == MODE_FDNS)
@@ -1220,11 +1309,27 @@ void StatsDialog::cycleReady() {
 		updateCaps();
 	else if (mode_ == MODE_FIREWALL)
 		updateFirewall();
+
+	showGraphs();
+	pages_->setCurrentWidget((mode_ == MODE_TOP)? topPage_: procView_);
+	Db::instance().release();
+	snap_ = 0;
+}
+
+// a row in the sandbox table was double-clicked, open the sandbox page
+void StatsDialog::sandboxActivated(const QModelIndex &index) {
+	int pid = index.sibling(index.row(), SandboxModel::COL_PID).data(Qt::UserRole).toInt();
+	anchorClicked(QUrl(QString::number(pid)));
+}
+
+void StatsDialog::linkActivated(const QString &link) {
+	anchorClicked(QUrl(link));
 }
 
 void StatsDialog::anchorClicked(const QUrl & link) {
 	cleanStorage(); // full storage cleanup on any click
 	QString linkstr = link.toString();
+	int pid = pid_;
 
 	if (linkstr == "top") {
 		mode_ = MODE_TOP;
@@ -1265,6 +1370,9 @@ void StatsDialog::anchorClicked(const QUrl & link) {
 	else if (linkstr == "1min") {
 		graph_type_ = GRAPH_1MIN;
 	}
+	else if (linkstr == "archive") {
+		graph_type_ = GRAPH_ARCHIVE;
+	}
 	else if (linkstr == "network") {
 		mode_ = MODE_NETWORK;
 	}
@@ -1363,14 +1471,18 @@ void StatsDialog::anchorClicked(const QUrl & link) {
 	// reset fdns
 	fdns_first_run_ = true;
 
-	if (data_ready)
-		cycleReady();
+	// the queries running are about the sandbox we are leaving
+	if (pid_ != pid || mode_ == MODE_TOP || mode_ == MODE_FDNS || mode_ == MODE_FDNS_DUMP)
+		cancelJobs();
+
+	cycleReady();
 }
 
 
-static bool userNamespace(pid_t pid) {
+// child is the sandboxed process, as published in the database snapshot
+static bool userNamespace(pid_t child) {
 	if (arg_debug)
-		printf("Checking user namespace for pid %d\n", pid);
+		printf("Checking user namespace for pid %d\n", child);
 
 	// test user namespaces available in the kernel
 	struct stat s1;
@@ -1382,13 +1494,12 @@ static bool userNamespace(pid_t pid) {
 	else
 		return false;
 
-	pid = pid_find_child(pid);
-	if (pid == -1)
+	if (child == -1)
 		return false;
 
 	// read uid map
 	char *uidmap;
-	if (asprintf(&uidmap, "/proc/%u/uid_map", pid) == -1)
+	if (asprintf(&uidmap, "/proc/%u/uid_map", child) == -1)
 		errExit("asprintf");
 	FILE *fp = fopen(uidmap, "r");
 	if (!fp) {
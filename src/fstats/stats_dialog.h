@@ -25,12 +25,23 @@
 #include <QDialog>
 #include <QAction>
 #include <QSystemTrayIcon>
+#include <QByteArray>
 #include "fstats.h"
 
 class QTextBrowser;
 class QUrl;
+class QLabel;
+class QTableView;
+class QStackedWidget;
+class QModelIndex;
+class SandboxModel;
+class QGridLayout;
+class QScrollArea;
+class GraphWidget;
 
 class PidThread;
+class JobQueue;
+class DbSnapshot;
 
 
 extern "C" {
@@ -76,11 +87,19 @@ private slots:
 public slots:
 	void cycleReady();
 	void anchorClicked(const QUrl & link);
+	void linkActivated(const QString &link);
+	void sandboxActivated(const QModelIndex &index);
+	void jobFinished(int job, QByteArray output);
 	void trayActivated(QSystemTrayIcon::ActivationReason);
 
+protected:
+	void showEvent(QShowEvent *event);
+	void hideEvent(QHideEvent *event);
+	void changeEvent(QEvent *event);
+
 private:
 	QString header();
-	void kernelSecuritySettings();
+	void kernelSecuritySettings(pid_t child);
 	void updateTop();
 	void updateFdns();
 	inline QString printDump(int index);
@@ -93,6 +112,11 @@ private:
 	void updateFirewall();
 	void cleanStorage();
 	void createTrayActions();
+	GraphWidget *nextGraph();
+	void graphRow();
+	void showGraphs();
+	void submitJob(int job, const char *fmt);
+	void cancelJobs();
 
 private:
 	DnsReport *fdns_report_;
@@ -101,6 +125,16 @@ private:
 	bool fdns_first_run_;
 
 	QTextBrowser *procView_;
+	QWidget *topPage_;
+	QLabel *topHeader_;
+	QTableView *topView_;
+	SandboxModel *topModel_;
+	QStackedWidget *pages_;		// procView_ or the top page
+#define MAX_GRAPHS 20	// the network page has two graphs for each interface
+	QScrollArea *graphArea_;
+	QGridLayout *graphLayout_;
+	GraphWidget *graphs_[MAX_GRAPHS];
+	int graph_cnt_;		// graphs shown in this cycle
 
 #define MODE_TOP 0
 #define MODE_PID 1
@@ -134,10 +168,27 @@ private:
 	bool have_join_;
 	int caps_cnt_;
 	GraphType graph_type_;
-	bool net_none_;
 
 	PidThread *thread_;
 
+	// firejail and firemon queries about the sandbox on the page, run in the background
+#define JOB_CAPS 0
+#define JOB_SECCOMP 1
+#define JOB_CPU 2
+#define JOB_PROTOCOL 3
+#define JOB_MDWX 4
+#define JOB_APPARMOR 5
+#define JOB_TREE 6
+#define JOB_SECCOMP_PRINT 7
+#define JOB_CAPS_PRINT 8
+#define JOB_NETFILTER 9
+#define JOB_DNS 10
+#define JOB_NET 11
+#define JOB_PLACEHOLDER "..."	// shown until the result arrives
+	JobQueue *jobs_;
+	unsigned jobs_pending_;	// bit mask of the jobs submitted and not finished yet
+	DbSnapshot *snap_;	// database cycle being rendered, valid inside cycleReady() only
+
 	// storage for various sandbox settings
 	QString storage_dns_;
 	QString storage_caps_;
@@ -145,6 +196,7 @@ private:
 	QString storage_intro_;
 	QString storage_network_;
 	QString storage_netfilter_;
+	QString storage_tree_;
 
 	char *shm_file_name_;
 public: